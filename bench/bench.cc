@@ -0,0 +1,425 @@
+#include "vm/context.h"
+#include "vm/vm.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Benchmark harness for the //bench package, printing one JSON document on
+// stdout. It runs:
+//
+//   - every program in the corpus directory, plus generated ones (many
+//     globals, a huge file), under each engine,
+//   - scanner, parser and interpreter microbenchmarks over generated inputs
+//     of increasing size,
+//   - a small rule evaluated many times through a Context, compiled once or
+//     for every call,
+//   - one compiled program evaluated by 1, 2, 4 and as many threads as there
+//     are cores, each with a Context of its own, for throughput scaling.
+//
+// Each benchmark runs in its own child process. Its peak RSS is then its own,
+// and the Vm's static state starts out fresh. The child runs the benchmark
+// --repeat times and sends its best time to the parent through a pipe.
+//
+// Usage: bench [--corpus=dir] [--filter=substring] [--repeat=n]
+
+struct Sample {
+  size_t bytes = 0;
+  size_t ops = 0;
+  double ns = 0;
+};
+
+struct Benchmark {
+  string name;
+  string kind;
+  string engine;
+  // What ops counts, for the reader of the JSON.
+  string unit;
+  function<Sample()> run;
+};
+
+static double now_ns() {
+  return chrono::duration<double, nano>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// A mix of the constructs real scripts use, one statement per line: number
+// and string globals, comments, blocks with locals, branches and loops.
+static string generate(size_t statements) {
+  string source;
+
+  for (size_t i = 0; i < statements; i++) {
+    string n = to_string(i);
+
+    switch (i % 4) {
+    case 0:
+      source += "var v" + n + " = " + n + " * 2 + 1; // number\n";
+      break;
+    case 1:
+      source += "var v" + n + " = \"s" + n + "\" + \"x\";\n";
+      break;
+    case 2:
+      source += "{ var t = v" + to_string(i - 2) +
+                "; if (t > 10) { t = t - 1; } else t = t + 1; }\n";
+      break;
+    default:
+      source += "/* dead loop */ while (false) { print v" +
+                to_string(i - 1) + "; }\n";
+      break;
+    }
+  }
+
+  return source;
+}
+
+// Defines globals globals and reads every one of them in each of rounds
+// passes of a loop.
+static string generate_globals(size_t globals, size_t rounds) {
+  string source;
+
+  for (size_t i = 0; i < globals; i++) {
+    source += "var g" + to_string(i) + " = " + to_string(i) + ";\n";
+  }
+
+  source += "var total = 0;\nvar round = 0;\nwhile (round < " +
+            to_string(rounds) + ") {\n";
+
+  for (size_t i = 0; i < globals; i++) {
+    source += "  total = total + g" + to_string(i) + ";\n";
+  }
+
+  return source + "  round = round + 1;\n}\nprint total;\n";
+}
+
+static string generate_loop(size_t iterations) {
+  return "var sum = 0; var i = 0; while (i < " + to_string(iterations) +
+         ") { sum = sum + i * 2; i = i + 1; }";
+}
+
+static string write_temporary(const string &source) {
+  char path[] = "/tmp/lox_benchXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  ofstream file(path, ios::binary);
+  file << source;
+  return path;
+}
+
+static size_t file_size(const string &path) {
+  ifstream file(path, ios::binary | ios::ate);
+  return file ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+static Sample run_program(const string &path, const string &engine) {
+  string flag = "--engine=" + engine;
+  vector<char *> argv = {const_cast<char *>("cpp-lox"), flag.data(),
+                         const_cast<char *>(path.c_str())};
+
+  // Scripts print; the results are not what is being measured.
+  streambuf *previous = cout.rdbuf(nullptr);
+  double start = now_ns();
+  Vm::execute(static_cast<int>(argv.size()), argv.data());
+  double end = now_ns();
+  cout.rdbuf(previous);
+  cout.clear();
+
+  return Sample{file_size(path), 1, end - start};
+}
+
+static Sample scan(const string &source) {
+  double start = now_ns();
+  Scanner scanner = Scanner(source);
+  size_t tokens = scanner.scan_tokens().size();
+  return Sample{source.size(), tokens, now_ns() - start};
+}
+
+static Sample parse(const string &source) {
+  Scanner scanner = Scanner(source);
+  vector<Token> tokens = scanner.scan_tokens();
+
+  double start = now_ns();
+  Parser parser = Parser(tokens, scanner.literals());
+  size_t statements = parser.parse().size();
+  return Sample{source.size(), statements, now_ns() - start};
+}
+
+static Sample interpret(const string &source, size_t iterations, bool jit) {
+  Scanner scanner = Scanner(source);
+  vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+  Interpreter interpreter;
+  Resolver(&interpreter.global_environment()).resolve(statements);
+  Jit::enabled = jit;
+
+  double start = now_ns();
+  interpreter.interpret(statements);
+  return Sample{source.size(), iterations, now_ns() - start};
+}
+
+static Sample embed(size_t calls, bool compile_once) {
+  const string rule = "var score = base * 2;\n"
+                      "if (vip) score = score + 10;\n"
+                      "score > 50 and score < 1000;";
+  Context context;
+  unique_ptr<Program> program = context.compile(rule);
+
+  double start = now_ns();
+
+  for (size_t i = 0; i < calls; i++) {
+    if (!compile_once) {
+      program = context.compile(rule);
+    }
+
+    context.evaluate(*program, {{"base", Value(static_cast<double>(i))},
+                                {"vip", Value(i % 2 == 0)}});
+  }
+
+  return Sample{rule.size(), calls, now_ns() - start};
+}
+
+// Compiles a loop once and has threads threads evaluate it calls times each.
+// The time is wall time, so ops per second should grow with threads up to the
+// number of cores.
+static Sample shared(size_t threads, size_t calls) {
+  const string script = "var i = 0; var total = 0;\n"
+                        "while (i < limit) { total = total + i; i = i + 1; }\n"
+                        "total > 0;";
+  Context context;
+  unique_ptr<Program> program = context.compile(script);
+  vector<thread> workers;
+
+  double start = now_ns();
+
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&program, calls]() {
+      Context own;
+
+      for (size_t i = 0; i < calls; i++) {
+        own.evaluate(*program, {{"limit", Value(1000.0)}});
+      }
+    });
+  }
+
+  for (thread &worker : workers) {
+    worker.join();
+  }
+
+  return Sample{script.size(), threads * calls, now_ns() - start};
+}
+
+static vector<string> corpus(const string &directory) {
+  vector<string> paths;
+  DIR *dir = opendir(directory.c_str());
+
+  if (dir == nullptr) {
+    return paths;
+  }
+
+  while (dirent *entry = readdir(dir)) {
+    string name = entry->d_name;
+
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".lox") == 0) {
+      paths.push_back(directory + "/" + name);
+    }
+  }
+
+  closedir(dir);
+  sort(paths.begin(), paths.end());
+  return paths;
+}
+
+// Runs benchmark in a child and prints its JSON object. Returns false if the
+// child did not report a sample.
+static bool measure(const Benchmark &benchmark, int repeat, bool first) {
+  int fds[2];
+
+  if (pipe(fds) != 0) {
+    return false;
+  }
+
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    close(fds[0]);
+    Sample best;
+
+    for (int i = 0; i < repeat; i++) {
+      Sample sample = benchmark.run();
+
+      if (i == 0 || sample.ns < best.ns) {
+        best = sample;
+      }
+    }
+
+    char line[128];
+    int length = snprintf(line, sizeof(line), "%zu %zu %.0f\n", best.bytes,
+                          best.ops, best.ns);
+    ssize_t written = write(fds[1], line, static_cast<size_t>(length));
+    _exit(written == length ? 0 : 1);
+  }
+
+  close(fds[1]);
+
+  string reply;
+  char buffer[128];
+  ssize_t count;
+
+  while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+    reply.append(buffer, static_cast<size_t>(count));
+  }
+
+  close(fds[0]);
+
+  int status = 0;
+  rusage usage = {};
+  wait4(pid, &status, 0, &usage);
+
+  Sample sample;
+  bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+            sscanf(reply.c_str(), "%zu %zu %lf", &sample.bytes, &sample.ops,
+                   &sample.ns) == 3;
+
+  printf("%s\n    {\"name\": \"%s\", \"kind\": \"%s\", \"engine\": \"%s\", "
+         "\"ok\": %s",
+         first ? "" : ",", benchmark.name.c_str(), benchmark.kind.c_str(),
+         benchmark.engine.c_str(), ok ? "true" : "false");
+
+  if (ok) {
+    double seconds = sample.ns / 1e9;
+    printf(", \"bytes\": %zu, \"ops\": %zu, \"unit\": \"%s\", \"wall_ms\": "
+           "%.3f, \"ns_per_op\": %.1f, \"mb_per_s\": %.2f",
+           sample.bytes, sample.ops, benchmark.unit.c_str(), sample.ns / 1e6,
+           sample.ops > 0 ? sample.ns / sample.ops : 0.0,
+           seconds > 0 ? sample.bytes / 1e6 / seconds : 0.0);
+  }
+
+  // ru_maxrss is in kilobytes on Linux.
+  printf(", \"peak_rss_kb\": %ld}", usage.ru_maxrss);
+  fflush(stdout);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  string directory = "bench/corpus";
+  string filter;
+  int repeat = 3;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+
+    if (arg.rfind("--corpus=", 0) == 0) {
+      directory = arg.substr(9);
+    } else if (arg.rfind("--filter=", 0) == 0) {
+      filter = arg.substr(9);
+    } else if (arg.rfind("--repeat=", 0) == 0 && atoi(arg.c_str() + 9) > 0) {
+      repeat = atoi(arg.c_str() + 9);
+    } else {
+      cerr << "Usage: bench [--corpus=dir] [--filter=substring] [--repeat=n]"
+           << endl;
+      return 64;
+    }
+  }
+
+  vector<string> programs = corpus(directory);
+  vector<string> temporaries = {write_temporary(generate_globals(5000, 20)),
+                                write_temporary(generate(200000))};
+  vector<string> generated = {"many_globals", "huge_file"};
+  vector<Benchmark> benchmarks;
+
+  for (size_t i = 0; i < programs.size() + temporaries.size(); i++) {
+    bool in_corpus = i < programs.size();
+    string path = in_corpus ? programs[i] : temporaries[i - programs.size()];
+    string name = in_corpus ? path.substr(path.rfind('/') + 1)
+                            : generated[i - programs.size()];
+
+    for (string engine : {"tree", "closure", "bytecode"}) {
+      benchmarks.push_back({"program/" + name, "program", engine, "run",
+                            [path, engine]() {
+                              return run_program(path, engine);
+                            }});
+    }
+  }
+
+  for (size_t statements : {1000, 10000, 100000}) {
+    string size = to_string(statements);
+    benchmarks.push_back({"scanner/" + size, "scanner", "", "token",
+                          [statements]() {
+                            return scan(generate(statements));
+                          }});
+    benchmarks.push_back({"parser/" + size, "parser", "", "statement",
+                          [statements]() {
+                            return parse(generate(statements));
+                          }});
+  }
+
+  for (size_t iterations : {10000, 100000, 1000000}) {
+    string size = to_string(iterations);
+
+    for (bool jit : {false, true}) {
+      benchmarks.push_back({"interpreter/" + size, "interpreter",
+                            jit ? "tree+jit" : "tree", "iteration",
+                            [iterations, jit]() {
+                              return interpret(generate_loop(iterations),
+                                               iterations, jit);
+                            }});
+    }
+  }
+
+  for (size_t calls : {1000, 100000}) {
+    for (bool compile_once : {true, false}) {
+      benchmarks.push_back(
+          {string("embed/") + (compile_once ? "compile-once/" : "per-call/") +
+               to_string(calls),
+           "embed", "tree", "evaluation", [calls, compile_once]() {
+             return embed(calls, compile_once);
+           }});
+    }
+  }
+
+  vector<size_t> threads = {1, 2, 4};
+
+  if (thread::hardware_concurrency() > 4) {
+    threads.push_back(thread::hardware_concurrency());
+  }
+
+  for (size_t count : threads) {
+    benchmarks.push_back({"threads/" + to_string(count), "threads", "tree",
+                          "evaluation", [count]() {
+                            return shared(count, 2000);
+                          }});
+  }
+
+  printf("{\n  \"repeat\": %d,\n  \"benchmarks\": [", repeat);
+  bool first = true;
+  int failures = 0;
+
+  for (const Benchmark &benchmark : benchmarks) {
+    if (benchmark.name.find(filter) == string::npos) {
+      continue;
+    }
+
+    failures += !measure(benchmark, repeat, first);
+    first = false;
+  }
+
+  printf("\n  ]\n}\n");
+
+  for (const string &path : temporaries) {
+    remove(path.c_str());
+  }
+
+  return failures == 0 ? 0 : 1;
+}
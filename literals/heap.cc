@@ -0,0 +1,172 @@
+#include "literals/heap.h"
+#include "literals/value.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+Object::Object(size_t bytes) : bytes(bytes) { Heap::instance().track(this); }
+
+Heap &Heap::instance() {
+  static thread_local Heap heap;
+  return heap;
+}
+
+Heap::~Heap() {
+  while (objects != nullptr) {
+    Object *next = objects->next;
+    delete objects;
+    objects = next;
+  }
+}
+
+void Heap::track(Object *object) {
+  // Born marked: an object allocated during a cycle is reachable from
+  // somewhere the root snapshot cannot see yet.
+  object->mark = epoch;
+  object->next = objects;
+  objects = object;
+
+  allocated += object->bytes;
+  allocated_objects++;
+  heap_bytes += object->bytes;
+  peak_bytes = std::max(peak_bytes, heap_bytes);
+
+  if (on_track != nullptr) {
+    on_track(object->bytes);
+  }
+}
+
+void Heap::make_permanent(Object *object) { object->permanent = true; }
+
+void Heap::add_roots(const std::vector<Value> *roots) {
+  this->roots.push_back(roots);
+}
+
+void Heap::remove_roots(const std::vector<Value> *roots) {
+  this->roots.erase(std::find(this->roots.begin(), this->roots.end(), roots));
+}
+
+void Heap::work() {
+  double start = now_us();
+
+  if (phase == Phase::IDLE) {
+    if (heap_bytes < threshold) {
+      next_work = allocated + (threshold - heap_bytes);
+      return;
+    }
+
+    begin_cycle();
+  }
+
+  double deadline = mode == GcMode::FULL ? 0 : start + budget_us;
+
+  if (phase == Phase::MARK && mark(deadline)) {
+    phase = Phase::SWEEP;
+    sweep_cursor = &objects;
+  }
+
+  if (phase == Phase::SWEEP && sweep(deadline)) {
+    finish_cycle();
+  } else {
+    next_work = allocated + step_bytes;
+  }
+
+  pauses_us.push_back(now_us() - start);
+}
+
+void Heap::begin_cycle() {
+  phase = Phase::MARK;
+  epoch++;
+  gray.clear();
+
+  for (const std::vector<Value> *values : roots) {
+    for (const Value &value : *values) {
+      if (value.is_string())
+        gray.push_back(value.as_string());
+    }
+  }
+}
+
+bool Heap::mark(double deadline_us) {
+  size_t work = 0;
+
+  while (!gray.empty()) {
+    if (deadline_us != 0 && ++work % 1024 == 0 && now_us() >= deadline_us)
+      return false;
+
+    Object *object = gray.back();
+    gray.pop_back();
+
+    // Permanent objects are never swept, and may belong to no heap at all, so
+    // they are not marked either.
+    if (object->permanent || object->mark == epoch)
+      continue;
+
+    object->mark = epoch;
+    object->trace(gray);
+  }
+
+  return true;
+}
+
+bool Heap::sweep(double deadline_us) {
+  size_t work = 0;
+
+  while (*sweep_cursor != nullptr) {
+    if (deadline_us != 0 && ++work % 1024 == 0 && now_us() >= deadline_us)
+      return false;
+
+    Object *object = *sweep_cursor;
+
+    if (object->permanent || object->mark == epoch) {
+      sweep_cursor = &object->next;
+      continue;
+    }
+
+    *sweep_cursor = object->next;
+    heap_bytes -= object->bytes;
+    freed_bytes += object->bytes;
+    freed_objects++;
+    delete object;
+  }
+
+  return true;
+}
+
+void Heap::finish_cycle() {
+  phase = Phase::IDLE;
+  sweep_cursor = nullptr;
+  cycles++;
+  threshold = std::max(min_threshold, heap_bytes * 2);
+  next_work = allocated + (threshold - heap_bytes);
+}
+
+double Heap::now_us() {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Heap::report(std::ostream &out) const {
+  std::vector<double> sorted = pauses_us;
+  std::sort(sorted.begin(), sorted.end());
+
+  double total = 0;
+  for (double pause : sorted)
+    total += pause;
+
+  double max = sorted.empty() ? 0 : sorted.back();
+  double p99 = sorted.empty() ? 0 : sorted[(sorted.size() - 1) * 99 / 100];
+
+  out << std::fixed << std::setprecision(3);
+  out << "[gc] mode: "
+      << (mode == GcMode::FULL ? "full" : "incremental") << ", budget "
+      << budget_us / 1000 << " ms" << std::endl;
+  out << "[gc] collections: " << cycles << ", pauses: " << sorted.size()
+      << std::endl;
+  out << "[gc] pause total " << total / 1000 << " ms, max " << max / 1000
+      << " ms, p99 " << p99 / 1000 << " ms" << std::endl;
+  out << "[gc] heap: " << heap_bytes / 1024 << " KB live, "
+      << peak_bytes / 1024 << " KB peak, " << freed_objects
+      << " objects freed (" << freed_bytes / 1024 << " KB)" << std::endl;
+}
@@ -0,0 +1,99 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "literals/object.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class Value;
+
+enum class GcMode { FULL, INCREMENTAL };
+
+// Tracing mark-sweep collector owning every Object.
+//
+// The engines register the vectors holding their live values (globals,
+// locals, the value stack) as roots and call safepoint() wherever no other
+// Value is live, which is between statements for the Interpreter and between
+// instructions for the Machine. Collection only ever happens there.
+//
+// A cycle starts once the heap has grown past a threshold. It copies the
+// roots, marks everything reachable from that snapshot and then sweeps the
+// object list. In incremental mode the marking and sweeping are spread over
+// many safepoints, each doing at most budget_us microseconds of work, with a
+// new slice due after every step_bytes of allocation. Objects allocated
+// during a cycle are born marked, so together with the root snapshot every
+// object reachable when the cycle ends survives it. In full mode the whole
+// cycle runs in a single pause.
+//
+// instance() is the calling thread's heap, so scripts run on different
+// threads never share objects and collect independently. The one exception
+// is permanent objects outside every heap, such as the literals of a Program
+// that several threads run. Heaps only ever read those, and never mark or
+// free them.
+class Heap final {
+public:
+  static Heap &instance();
+  ~Heap();
+
+  void track(Object *object);
+  void make_permanent(Object *object);
+  void add_roots(const std::vector<Value> *roots);
+  void remove_roots(const std::vector<Value> *roots);
+
+  void safepoint() {
+    if (allocated >= next_work)
+      work();
+  }
+
+  void report(std::ostream &out) const;
+  size_t collections() const { return cycles; }
+  size_t live_bytes() const { return heap_bytes; }
+  size_t peak_live_bytes() const { return peak_bytes; }
+  size_t objects_allocated() const { return allocated_objects; }
+
+  // Called with the size of every object allocated, if set.
+  void (*on_track)(size_t bytes) = nullptr;
+
+  GcMode mode = GcMode::INCREMENTAL;
+  double budget_us = 500;
+  size_t step_bytes = 256 * 1024;
+  size_t min_threshold = 1024 * 1024;
+
+private:
+  enum class Phase { IDLE, MARK, SWEEP };
+
+  Heap() = default;
+
+  void work();
+  void begin_cycle();
+  // Each returns true once its phase is complete. With a zero deadline they
+  // run to completion.
+  bool mark(double deadline_us);
+  bool sweep(double deadline_us);
+  void finish_cycle();
+  static double now_us();
+
+  Object *objects = nullptr;
+  std::vector<const std::vector<Value> *> roots;
+  std::vector<Object *> gray;
+  Object **sweep_cursor = nullptr;
+  Phase phase = Phase::IDLE;
+  uint32_t epoch = 0;
+
+  // Bytes allocated since startup, which drives the pacing.
+  size_t allocated = 0;
+  size_t allocated_objects = 0;
+  size_t next_work = 1024 * 1024;
+  size_t heap_bytes = 0;
+  size_t threshold = 1024 * 1024;
+
+  size_t peak_bytes = 0;
+  size_t cycles = 0;
+  size_t freed_objects = 0;
+  size_t freed_bytes = 0;
+  std::vector<double> pauses_us;
+};
+
+#endif
@@ -1,3 +0,0 @@
-#include "literals/number.h"
-
-std::string Number::to_string() const { return std::to_string(value); }
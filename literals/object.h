@@ -1,11 +1,43 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
+// Base of every heap allocated runtime value. Objects register themselves
+// with the Heap on construction and are freed by its collector once no root
+// reaches them; nothing else deletes them, except for the few made untracked
+// by their owner.
 class Object {
 public:
+  explicit Object(size_t bytes);
+  virtual ~Object() = default;
+  Object(const Object &) = delete;
+  Object &operator=(const Object &) = delete;
+
   virtual std::string to_string() const = 0;
+  // Pushes the objects this one references. Strings reference nothing.
+  virtual void trace(std::vector<Object *> &gray) const {}
+
+protected:
+  enum class Untracked { UNTRACKED };
+
+  // For objects outside every Heap, which are permanent and deleted by
+  // whoever made them.
+  Object(size_t bytes, Untracked) : bytes(bytes), permanent(true) {}
+
+private:
+  friend class Heap;
+
+  Object *next = nullptr;
+  // Bytes charged to the heap for this object.
+  size_t bytes;
+  // Epoch of the last collection that found the object reachable.
+  uint32_t mark = 0;
+  // Never collected, like interned strings.
+  bool permanent = false;
 };
 
 #endif
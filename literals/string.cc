@@ -1,3 +1,158 @@
 #include "literals/string.h"
+#include "literals/heap.h"
+#include <vector>
 
-std::string String::to_string() const { return value; }
+namespace {
+
+// Open addressing with linear probing. The capacity is a power of two and the
+// table is kept at most half full.
+std::vector<String *> &slots() {
+  static thread_local std::vector<String *> slots(256, nullptr);
+  return slots;
+}
+
+thread_local size_t count = 0;
+
+} // namespace
+
+String::String(std::string value)
+    : Object(sizeof(String) + value.size()),
+      buffer(std::make_shared<std::string>(std::move(value))),
+      length(buffer->size()) {}
+
+String::String(std::string value, Untracked)
+    : Object(sizeof(String) + value.size(), Untracked::UNTRACKED),
+      buffer(std::make_shared<std::string>(std::move(value))),
+      length(buffer->size()) {}
+
+std::unique_ptr<String> String::literal(std::string_view text) {
+  std::unique_ptr<String> string(
+      new String(std::string(text), Untracked::UNTRACKED));
+  string->hash();
+  string->interned = true;
+  return string;
+}
+
+std::string String::to_string() const { return std::string(view()); }
+
+bool String::equals(const String &other) const {
+  if (this == &other)
+    return true;
+
+  return length == other.length && hash() == other.hash() &&
+         view() == other.view();
+}
+
+String *String::concat(const String &left, const String &right) {
+  // Someone already appended past left, whose bytes must stay untouched. An
+  // interned string may be a literal of a tree running on other threads, so
+  // its buffer is never appended to.
+  if (left.interned || left.buffer->size() != left.length) {
+    std::string value;
+    value.reserve(left.length + right.length);
+    value.append(left.view());
+    value.append(right.view());
+    return new String(std::move(value));
+  }
+
+  // Appending may reallocate the buffer right points into.
+  if (right.buffer == left.buffer) {
+    left.buffer->append(std::string(right.view()));
+  } else {
+    left.buffer->append(right.view());
+  }
+
+  return new String(left.buffer, left.length + right.length, right.length);
+}
+
+uint32_t String::hash() const {
+  if (!hashed) {
+    cached_hash = hash_of(view());
+    hashed = true;
+  }
+
+  return cached_hash;
+}
+
+// 32 bit FNV-1a.
+uint32_t String::hash_of(std::string_view text) {
+  uint32_t hash = 2166136261u;
+
+  for (char c : text) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+String *StringTable::intern(std::string_view text) {
+  uint32_t hash = String::hash_of(text);
+  String *existing = find(text, hash);
+
+  if (existing != nullptr)
+    return existing;
+
+  String *string = new String(std::string(text));
+  insert(string);
+  return string;
+}
+
+String *StringTable::intern(String *string) {
+  if (string->interned)
+    return string;
+
+  String *existing = find(string->view(), string->hash());
+
+  if (existing != nullptr)
+    return existing;
+
+  insert(string);
+  return string;
+}
+
+String *StringTable::find(std::string_view text, uint32_t hash) {
+  std::vector<String *> &table = slots();
+  size_t mask = table.size() - 1;
+
+  for (size_t i = hash & mask; table[i] != nullptr; i = (i + 1) & mask) {
+    if (table[i]->hash() == hash && table[i]->view() == text)
+      return table[i];
+  }
+
+  return nullptr;
+}
+
+void StringTable::insert(String *string) {
+  std::vector<String *> &table = slots();
+
+  if ((count + 1) * 2 > table.size()) {
+    std::vector<String *> grown(table.size() * 2, nullptr);
+    size_t mask = grown.size() - 1;
+
+    for (String *entry : table) {
+      if (entry == nullptr)
+        continue;
+
+      size_t i = entry->hash() & mask;
+
+      while (grown[i] != nullptr)
+        i = (i + 1) & mask;
+
+      grown[i] = entry;
+    }
+
+    table.swap(grown);
+  }
+
+  size_t mask = table.size() - 1;
+  size_t i = string->hash() & mask;
+
+  while (table[i] != nullptr)
+    i = (i + 1) & mask;
+
+  table[i] = string;
+  string->interned = true;
+  Heap::instance().make_permanent(string);
+  count++;
+}
@@ -2,14 +2,68 @@
 #define STRING_H
 
 #include "literals/object.h"
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 
+// Immutable string stored as a prefix of a growable buffer that can be shared
+// with longer strings. Concatenating onto a string that ends its buffer
+// appends in place, so building a string piece by piece in a loop costs
+// amortized O(1) per appended byte instead of copying the whole prefix every
+// time. Bytes before a string's length are never modified, so every string
+// sharing the buffer keeps seeing the same contents.
+//
+// The hash is computed on first use and cached, or when the string is
+// interned, after which an interned string is never written to again.
 class String final : public Object {
 public:
-  String(std::string value) : value(value) {}
+  String(std::string value);
   std::string to_string() const;
+  bool equals(const String &other) const;
 
-  std::string value;
+  static String *concat(const String &left, const String &right);
+  // A permanent copy of text outside every Heap, hashed and marked interned
+  // up front so that threads only ever read it. For the literals of a
+  // Program, which may outlive the thread that compiled it.
+  static std::unique_ptr<String> literal(std::string_view text);
+  static uint32_t hash_of(std::string_view text);
+
+  std::string_view view() const {
+    return std::string_view(buffer->data(), length);
+  }
+  size_t size() const { return length; }
+  uint32_t hash() const;
+
+  // Set by StringTable::intern, which makes the string permanent, and on
+  // literals.
+  bool interned = false;
+
+private:
+  String(std::string value, Untracked);
+  String(std::shared_ptr<std::string> buffer, size_t length, size_t appended)
+      : Object(sizeof(String) + appended), buffer(std::move(buffer)),
+        length(length) {}
+
+  std::shared_ptr<std::string> buffer;
+  size_t length;
+  mutable uint32_t cached_hash = 0;
+  mutable bool hashed = false;
+};
+
+// Canonical copies of string contents. Literals are interned by the Scanner
+// and constant folding; strings built at runtime stay uninterned unless a
+// caller asks for the canonical copy. Like the Heap the table is per thread,
+// so two interned strings with the same contents may still be distinct
+// objects.
+class StringTable final {
+public:
+  static String *intern(std::string_view text);
+  static String *intern(String *string);
+
+private:
+  static String *find(std::string_view text, uint32_t hash);
+  static void insert(String *string);
 };
 
 #endif
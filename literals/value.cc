@@ -0,0 +1,51 @@
+#include "literals/value.h"
+#include <cmath>
+#include <cstring>
+
+Value::Value(double number) {
+  // Computations only ever produce the canonical quiet NaN, but one with a
+  // payload would otherwise be mistaken for a tagged value.
+  if (std::isnan(number))
+    number = NAN;
+
+  std::memcpy(&bits, &number, sizeof(double));
+}
+
+double Value::as_number() const {
+  double number;
+  std::memcpy(&number, &bits, sizeof(double));
+  return number;
+}
+
+bool Value::is_truthy() const {
+  if (is_nil())
+    return false;
+
+  if (is_bool())
+    return as_bool();
+
+  return true;
+}
+
+bool Value::operator==(const Value &other) const {
+  if (is_number() && other.is_number())
+    return as_number() == other.as_number();
+
+  if (is_string() && other.is_string())
+    return as_string()->equals(*other.as_string());
+
+  return bits == other.bits;
+}
+
+std::string Value::to_string() const {
+  if (is_nil())
+    return "nil";
+
+  if (is_bool())
+    return as_bool() ? "true" : "false";
+
+  if (is_number())
+    return std::to_string(as_number());
+
+  return as_string()->to_string();
+}
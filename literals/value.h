@@ -0,0 +1,49 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "literals/string.h"
+#include <cstdint>
+#include <string>
+
+// A runtime value packed into 64 bits. Numbers are stored as plain doubles,
+// everything else hides in the payload of a quiet NaN: nil, false and true use
+// small tags and strings set the sign bit and keep their pointer in the low
+// 48 bits. Strings are owned by the Heap, so copying a Value is a plain 64 bit
+// copy. Strings compare by content.
+class Value final {
+public:
+  Value() : bits(QNAN | TAG_NIL) {}
+  Value(double number);
+  Value(bool boolean) : bits(QNAN | (boolean ? TAG_TRUE : TAG_FALSE)) {}
+  Value(String *string)
+      : bits(SIGN_BIT | QNAN | reinterpret_cast<uint64_t>(string)) {}
+
+  bool is_nil() const { return bits == (QNAN | TAG_NIL); }
+  bool is_bool() const { return (bits | 1) == (QNAN | TAG_TRUE); }
+  bool is_number() const { return (bits & QNAN) != QNAN; }
+  bool is_string() const {
+    return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT);
+  }
+
+  double as_number() const;
+  bool as_bool() const { return bits == (QNAN | TAG_TRUE); }
+  String *as_string() const {
+    return reinterpret_cast<String *>(bits & ~(SIGN_BIT | QNAN));
+  }
+
+  bool is_truthy() const;
+  bool operator==(const Value &other) const;
+  bool operator!=(const Value &other) const { return !(*this == other); }
+  std::string to_string() const;
+
+private:
+  static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+  static constexpr uint64_t QNAN = 0x7ffc000000000000;
+  static constexpr uint64_t TAG_NIL = 1;
+  static constexpr uint64_t TAG_FALSE = 2;
+  static constexpr uint64_t TAG_TRUE = 3;
+
+  uint64_t bits;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "vm/batch.h"
+#include "vm/session.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+void write(const std::string &path, const std::string &text) {
+  std::ofstream(path) << text;
+}
+
+int assert_results(std::string message, const std::string &target,
+                   const std::string &expected, int expected_status) {
+  std::vector<std::string> paths;
+
+  if (!Batch::scripts(target, paths)) {
+    std::cout << message << ": could not read " << target << std::endl;
+    return 1;
+  }
+
+  std::stringstream output;
+  int status = Batch::run(paths, 4, output);
+
+  if (output.str() != expected || status != expected_status) {
+    std::cout << message << ": exited with " << status << " and printed\n"
+              << output.str() << "instead of\n"
+              << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  char directory[] = "/tmp/lox_batch_testXXXXXX";
+  std::string dir = mkdtemp(directory);
+
+  // Each script fails differently, and the passing ones print more than
+  // one line, so mixed up sessions would show.
+  write(dir + "/a.lox", "print 1; print \"a\\tb\";");
+  write(dir + "/b.lox", "print 2;\nprint -\"x\";\nprint 3;");
+  write(dir + "/c.lox", "print (;");
+  write(dir + "/d.lox", "var i = 0; while (i < 1000) i = i + 1; print i;");
+  write(dir + "/notes.txt", "print 0;");
+  write(dir + "/manifest", "# comment\n\nd.lox\na.lox\nmissing.lox\n");
+
+  std::string a = "{\"script\":\"" + dir +
+                  "/a.lox\",\"exit\":0,\"stdout\":\"1.000000\\na\\\\tb\\n\","
+                  "\"stderr\":\"\"}\n";
+  std::string b = "{\"script\":\"" + dir +
+                  "/b.lox\",\"exit\":70,\"stdout\":\"2.000000\\nOperand must "
+                  "be a number.\\n[line 2]\\n\",\"stderr\":\"\"}\n";
+  std::string c = "{\"script\":\"" + dir +
+                  "/c.lox\",\"exit\":65,\"stdout\":\"[line 1] Error at ';': "
+                  "Expect expression.\\n\",\"stderr\":\"\"}\n";
+  std::string d = "{\"script\":\"" + dir +
+                  "/d.lox\",\"exit\":0,\"stdout\":\"1000.000000\\n\","
+                  "\"stderr\":\"\"}\n";
+  std::string missing = "{\"script\":\"" + dir +
+                        "/missing.lox\",\"exit\":74,\"stdout\":\"Could not "
+                        "read file '" +
+                        dir + "/missing.lox'.\\n\",\"stderr\":\"\"}\n";
+
+  if (assert_results("Test running a directory", dir, a + b + c + d, 1))
+    return 1;
+
+  if (assert_results("Test running a manifest", dir + "/manifest",
+                     d + a + missing, 1))
+    return 1;
+
+  write(dir + "/manifest", "a.lox\nd.lox\n");
+
+  if (assert_results("Test a passing batch", dir + "/manifest", a + d, 0))
+    return 1;
+
+  if (!Session::current().out.good() || Session::current().had_error ||
+      Session::current().had_runtime_error) {
+    std::cout << "Test the scripts left the standard session alone"
+              << std::endl;
+    return 1;
+  }
+
+  for (const char *name :
+       {"a.lox", "b.lox", "c.lox", "d.lox", "notes.txt", "manifest"}) {
+    remove((dir + "/" + name).c_str());
+  }
+
+  rmdir(dir.c_str());
+  return 0;
+}
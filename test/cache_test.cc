@@ -0,0 +1,130 @@
+#include "vm/interpreter.h"
+#include "vm/optimizer.h"
+#include "vm/parser.h"
+#include "vm/program_cache.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+// Covers every node kind, literals of every type, blocks, an else-less if
+// and a desugared for loop.
+const std::string program =
+    "var a = 1.5; var s = \"str\" + \"ing\"; var n = nil;\n"
+    "var t = true; var f = false;\n"
+    "{ var local = -a * (2 + 3); print local; }\n"
+    "if (t and !f) print s; else print n;\n"
+    "if (f or a > 1) { a = a - 1; }\n"
+    "for (var i = 0; i < 3; i = i + 1) print i == 2;\n"
+    "print a;";
+
+vector<shared_ptr<Stmt>> parse(const std::string &source) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  return Optimizer(1).optimize(parser.parse());
+}
+
+std::string run(const vector<shared_ptr<Stmt>> &statements) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Resolver().resolve(statements);
+  Interpreter().interpret(statements);
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+int assert_round_trip(std::string message, const std::string &path) {
+  if (!ProgramCache::save(path, program, 1, parse(program))) {
+    std::cout << message << ": could not save" << std::endl;
+    return 1;
+  }
+
+  vector<shared_ptr<Stmt>> statements;
+
+  if (!ProgramCache::load(path, program, 1, statements)) {
+    std::cout << message << ": could not load" << std::endl;
+    return 1;
+  }
+
+  std::string expected = run(parse(program));
+  std::string output = run(statements);
+
+  if (output != expected) {
+    std::cout << message << ": printed\n"
+              << output << "instead of\n"
+              << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int assert_miss(std::string message, const std::string &path,
+                const std::string &source, int optimization) {
+  vector<shared_ptr<Stmt>> statements;
+
+  if (ProgramCache::load(path, source, optimization, statements)) {
+    std::cout << message << ": loaded a stale or damaged cache" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  char path[] = "/tmp/lox_cache_testXXXXXX";
+  close(mkstemp(path));
+
+  if (assert_round_trip("Test a cached program runs the same", path))
+    return 1;
+
+  std::string edited = program;
+  edited[edited.size() - 2] = 's';
+
+  if (assert_miss("Test an edited source misses", path, edited, 1))
+    return 1;
+
+  if (assert_miss("Test another optimization level misses", path, program, 0))
+    return 1;
+
+  // Drops the string literals off the end.
+  std::ifstream in(path, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  in.close();
+  std::streamsize truncated =
+      static_cast<std::streamsize>(contents.size() - 3);
+  std::ofstream(path, std::ios::binary).write(contents.data(), truncated);
+
+  if (assert_miss("Test a truncated file misses", path, program, 1))
+    return 1;
+
+  // Gives the first record, right after the header, an unknown kind.
+  std::string damaged = contents;
+  damaged[56] = '\x7f';
+  std::ofstream(path, std::ios::binary)
+      .write(damaged.data(), static_cast<std::streamsize>(damaged.size()));
+
+  if (assert_miss("Test a damaged file misses", path, program, 1))
+    return 1;
+
+  // Turns "string", the last literal, into "strong": still a valid tree,
+  // but of another program.
+  damaged = contents;
+  damaged[damaged.size() - 3] = 'o';
+  std::ofstream(path, std::ios::binary)
+      .write(damaged.data(), static_cast<std::streamsize>(damaged.size()));
+
+  if (assert_miss("Test a changed literal misses", path, program, 1))
+    return 1;
+
+  remove(path);
+  return 0;
+}
@@ -0,0 +1,233 @@
+#include "vm/context.h"
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// A rule of the kind a service evaluates per request: reads bound globals,
+// prints, leaves a global behind and ends with its result.
+const std::string rule = "var score = base * 2;\n"
+                         "if (vip) score = score + 10;\n"
+                         "print name + \": \" + \"checked\";\n"
+                         "score > 50;";
+
+int assert_evaluates(std::string message, Context &context,
+                     const Program &program,
+                     const vector<pair<string, Value>> &globals,
+                     const std::string &value, const std::string &output) {
+  Evaluation evaluation = context.evaluate(program, globals);
+
+  if (!evaluation.ok() || evaluation.value.to_string() != value ||
+      evaluation.output != output) {
+    std::cout << message << ": returned " << evaluation.value.to_string()
+              << " and printed\n"
+              << evaluation.output << "instead of " << value
+              << " and\n"
+              << output << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int assert_error(std::string message, const Evaluation &evaluation,
+                 ScriptError::Kind kind, int line, const std::string &where,
+                 const std::string &text) {
+  if (evaluation.errors.size() != 1 || evaluation.errors[0].kind != kind ||
+      evaluation.errors[0].line != line ||
+      evaluation.errors[0].where != where ||
+      evaluation.errors[0].message != text) {
+    std::cout << message << ": got " << evaluation.errors.size()
+              << " errors, the first being '"
+              << (evaluation.errors.empty() ? ""
+                                            : evaluation.errors[0].message)
+              << "'" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int assert_silent(std::string message, Context &context,
+                  const Program &program) {
+  std::stringstream printed;
+  std::streambuf *previous = std::cout.rdbuf(printed.rdbuf());
+  context.evaluate(program, {{"base", Value(1.0)},
+                             {"vip", Value(true)},
+                             {"name", context.make_string("dee")}});
+  context.evaluate(program);
+  std::cout.rdbuf(previous);
+
+  if (!printed.str().empty()) {
+    std::cout << message << ": printed\n" << printed.str() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+// Each thread evaluates program with a Context of its own and globals of its
+// own, and checks every result.
+int assert_shared(std::string message, const Program &program) {
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&program, &failures, t]() {
+      Context context;
+
+      for (int i = 0; i < 200; i++) {
+        Evaluation evaluation = context.evaluate(
+            program, {{"limit", Value(100.0 + t * 10 + i)},
+                      {"step", Value(t + 1.0)},
+                      {"tag", context.make_string(std::to_string(t))}});
+
+        if (!evaluation.ok() || evaluation.value.to_string() != "true") {
+          failures++;
+        }
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  if (failures > 0) {
+    std::cout << message << ": " << failures << " wrong results" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  Context context;
+  unique_ptr<Program> program = context.compile(rule);
+
+  if (assert_evaluates("Test evaluating with bound globals", context,
+                       *program,
+                       {{"base", Value(30.0)},
+                        {"vip", Value(false)},
+                        {"name", context.make_string("ann")}},
+                       "true", "ann: checked\n"))
+    return 1;
+
+  if (assert_evaluates("Test evaluating the same program again", context,
+                       *program,
+                       {{"base", Value(20.0)},
+                        {"vip", Value(true)},
+                        {"name", context.make_string("bob")}},
+                       "false", "bob: checked\n"))
+    return 1;
+
+  if (context.global("score").to_string() != "50.000000" ||
+      !context.global("missing").is_nil()) {
+    std::cout << "Test reading a global back" << std::endl;
+    return 1;
+  }
+
+  if (assert_error(
+          "Test a runtime error is returned",
+          context.evaluate(*program, {{"base", context.make_string("x")}}),
+          ScriptError::Kind::RUNTIME, 1, "", "Operands must be numbers."))
+    return 1;
+
+  // Globals do not carry over, so the rule no longer sees base.
+  if (assert_error("Test globals are cleared between evaluations",
+                   context.evaluate(*program), ScriptError::Kind::RUNTIME, 1,
+                   "", "Undefined variable 'base'."))
+    return 1;
+
+  if (assert_evaluates("Test a program still runs after an error", context,
+                       *program,
+                       {{"base", Value(1.0)},
+                        {"vip", Value(true)},
+                        {"name", context.make_string("cy")}},
+                       "false", "cy: checked\n"))
+    return 1;
+
+  if (assert_silent("Test nothing is printed", context, *program))
+    return 1;
+
+  unique_ptr<Program> broken = context.compile("var a = 1;\nprint (;");
+
+  if (broken->ok()) {
+    std::cout << "Test a syntax error fails to compile" << std::endl;
+    return 1;
+  }
+
+  if (assert_error("Test a syntax error is returned", context.evaluate(*broken),
+                   ScriptError::Kind::SYNTAX, 2, "at ';'",
+                   "Expect expression."))
+    return 1;
+
+  // Enough garbage for several collections before the result is made, so
+  // the bound string has to be kept alive by the Context.
+  unique_ptr<Program> strings = context.compile(
+      "var i = 0;\n"
+      "while (i < 100000) { var s = prefix + \"-\"; i = i + 1; }\n"
+      "prefix + \"-!\";");
+
+  for (int i = 0; i < 3; i++) {
+    std::string prefix = "p" + std::to_string(i);
+
+    if (assert_evaluates("Test a bound string survives collections", context,
+                         *strings, {{"prefix", context.make_string(prefix)}},
+                         prefix + "-!", ""))
+      return 1;
+  }
+
+  // Long enough for the Jit, whose native loop reads the bound globals.
+  unique_ptr<Program> loop = context.compile(
+      "var i = 0; var total = 0;\n"
+      "while (i < limit) { total = total + step; i = i + 1; }\n"
+      "total;");
+
+  if (assert_evaluates("Test a compiled loop sees new globals", context, *loop,
+                       {{"limit", Value(1000.0)}, {"step", Value(2.0)}},
+                       "2000.000000", "") ||
+      assert_evaluates("Test a compiled loop sees new globals", context, *loop,
+                       {{"limit", Value(500.0)}, {"step", Value(3.0)}},
+                       "1500.000000", ""))
+    return 1;
+
+  Context other;
+
+  if (assert_evaluates("Test a program runs on another context", other,
+                       *program,
+                       {{"base", Value(40.0)},
+                        {"vip", Value(false)},
+                        {"name", other.make_string("eve")}},
+                       "true", "eve: checked\n"))
+    return 1;
+
+  // Runs hot loops for the Jit, specializes sites, concatenates onto string
+  // literals and collects, all on a tree the threads share.
+  unique_ptr<Program> shared = context.compile(
+      "var i = 0; var total = 0; var s = \"\";\n"
+      "while (i < limit) { total = total + step; i = i + 1; }\n"
+      "while (i > 0) { s = \"-\" + tag; i = i - 1; }\n"
+      "s == \"-\" + tag and total == limit * step;");
+
+  if (assert_shared("Test a program runs on many threads at once", *shared))
+    return 1;
+
+  // The compiling thread's Heap and StringTable are gone by the time the
+  // program runs, folded literal included.
+  unique_ptr<Program> orphan;
+  std::thread compiler([&orphan]() {
+    Context compiling;
+    orphan = compiling.compile("var greeting = \"hello\" + \" world\";\n"
+                               "print greeting;\n"
+                               "greeting + \"!\";");
+  });
+  compiler.join();
+
+  if (assert_evaluates("Test a program outlives the thread that compiled it",
+                       context, *orphan, {}, "hello world!",
+                       "hello world\n"))
+    return 1;
+
+  return 0;
+}
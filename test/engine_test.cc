@@ -0,0 +1,220 @@
+#include "vm/closure_compiler.h"
+#include "vm/compiler.h"
+#include "vm/interpreter.h"
+#include "vm/machine.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <iostream>
+#include <sstream>
+
+std::string run_tree(std::string source) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+  Resolver resolver = Resolver();
+  resolver.resolve(statements);
+  Interpreter interpreter = Interpreter();
+  interpreter.interpret(statements);
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+std::string run_bytecode(std::string source) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  Compiler compiler = Compiler();
+  Chunk chunk = compiler.compile(parser.parse());
+  Machine machine = Machine();
+  machine.interpret(chunk);
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+std::string run_closure(std::string source) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  ClosureCompiler closures = ClosureCompiler();
+  closures.interpret(parser.parse());
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+std::string run_stream(std::string source) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Scanner scanner = Scanner(source);
+  Parser parser = Parser(scanner);
+  Resolver resolver = Resolver();
+  Interpreter interpreter = Interpreter();
+
+  while (!parser.is_at_end()) {
+    vector<shared_ptr<Stmt>> statement = {parser.parse_declaration()};
+    resolver.resolve(statement);
+    interpreter.interpret(statement);
+  }
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+int assert_same_output(std::string message, std::string source,
+                       std::string expected) {
+  std::string tree = run_tree(source);
+  std::string bytecode = run_bytecode(source);
+  std::string closure = run_closure(source);
+  std::string stream = run_stream(source);
+
+  if (tree != expected) {
+    std::cout << message << ": interpreter printed\n" << tree << std::endl;
+    return 1;
+  }
+
+  if (bytecode != expected) {
+    std::cout << message << ": bytecode printed\n" << bytecode << std::endl;
+    return 1;
+  }
+
+  if (closure != expected) {
+    std::cout << message << ": closures printed\n" << closure << std::endl;
+    return 1;
+  }
+
+  if (stream != expected) {
+    std::cout << message << ": streaming printed\n" << stream << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  if (assert_same_output("Test arithmetic", "print 1 + 2 * 3 - 4 / 2;",
+                         "5.000000\n"))
+    return 1;
+
+  if (assert_same_output("Test strings", "print \"a\" + \"b\";", "ab\n"))
+    return 1;
+
+  if (assert_same_output("Test globals",
+                         "var a = 1; var b; a = a + 1; print a; print b;",
+                         "2.000000\nnil\n"))
+    return 1;
+
+  if (assert_same_output("Test redefinition keeps the first value",
+                         "var a = 1; var a = 2; print a; { var b = 1; var b "
+                         "= 2; print b; }",
+                         "1.000000\n1.000000\n"))
+    return 1;
+
+  if (assert_same_output("Test block scoping",
+                         "var a = \"global\"; { var a = \"outer\"; { var a "
+                         "= a + \"!\"; print a; } print a; } print a;",
+                         "outer!\nouter\nglobal\n"))
+    return 1;
+
+  if (assert_same_output("Test assignment to outer scopes",
+                         "var a = 1; { var b = 2; { a = b = 3; } print b; } "
+                         "print a;",
+                         "3.000000\n3.000000\n"))
+    return 1;
+
+  if (assert_same_output("Test if and else",
+                         "if (1 > 2) print \"then\"; else print \"else\"; if "
+                         "(nil) print \"nil\";",
+                         "else\n"))
+    return 1;
+
+  if (assert_same_output("Test while and for",
+                         "var i = 0; while (i < 2) i = i + 1; print i; for "
+                         "(var j = 0; j < 3; j = j + 1) { var k = j * 2; "
+                         "print k; }",
+                         "2.000000\n0.000000\n2.000000\n4.000000\n"))
+    return 1;
+
+  if (assert_same_output("Test logical operators",
+                         "print nil or \"right\"; print false and 1; print 1 "
+                         "and 2; print \"left\" or 2;",
+                         "right\nfalse\n2.000000\nleft\n"))
+    return 1;
+
+  if (assert_same_output("Test unary operators",
+                         "var a = 1; print -a; print a; print !nil; print "
+                         "!!a;",
+                         "-1.000000\n1.000000\ntrue\ntrue\n"))
+    return 1;
+
+  if (assert_same_output("Test equality",
+                         "var s = \"s\"; print s == s; print nil == nil; print "
+                         "s != nil; print 1 + 1 == 2; print true != false;",
+                         "true\ntrue\ntrue\ntrue\ntrue\n"))
+    return 1;
+
+  if (assert_same_output("Test string equality is by content",
+                         "var a = \"ab\"; print a == \"ab\"; print \"a\" + "
+                         "\"b\" == a; print a != \"a\" + \"c\"; print "
+                         "\"ab\" == \"a\";",
+                         "true\ntrue\ntrue\nfalse\n"))
+    return 1;
+
+  if (assert_same_output("Test appending keeps earlier strings intact",
+                         "var a = \"x\"; var b = a + \"y\"; var c = a + "
+                         "\"z\"; var d = b + b; print a; print b; print c; "
+                         "print d; print b + \"!\" == d;",
+                         "x\nxy\nxz\nxyxy\nfalse\n"))
+    return 1;
+
+  if (assert_same_output("Test sites that change operand types",
+                         "var a = 1; var i = 0; while (i < 3) { print a + a; "
+                         "print -a; a = \"s\"; i = i + 1; }",
+                         "2.000000\n-1.000000\nss\nOperand must be a "
+                         "number.\n[line 1]\n"))
+    return 1;
+
+  if (assert_same_output("Test undefined variable", "print 1;\nprint a;",
+                         "1.000000\nUndefined variable 'a'.\n[line 2]\n"))
+    return 1;
+
+  if (assert_same_output("Test operand errors", "print 1;\n\"a\" - 1;",
+                         "1.000000\nOperands must be numbers.\n[line 2]\n"))
+    return 1;
+
+  if (assert_same_output("Test mixed addition", "\n\n1 + \"a\";",
+                         "Operands must be two numbers or two strings.\n[line "
+                         "3]\n"))
+    return 1;
+
+  // "a + a" specializes to numbers and deoptimizes on strings, "i < 2" and
+  // "i + 1" stay specialized.
+  FeedbackStats before = Interpreter::feedback;
+  run_tree("var a = 1; var i = 0; while (i < 2) { a = a + a; a = \"s\"; i = "
+           "i + 1; }");
+
+  if (Interpreter::feedback.specialized != before.specialized + 3 ||
+      Interpreter::feedback.deoptimized != before.deoptimized + 1) {
+    std::cout << "Test feedback counters: specialized "
+              << Interpreter::feedback.specialized - before.specialized
+              << ", deoptimized "
+              << Interpreter::feedback.deoptimized - before.deoptimized
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
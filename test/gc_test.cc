@@ -0,0 +1,97 @@
+#include "literals/heap.h"
+#include "vm/compiler.h"
+#include "vm/interpreter.h"
+#include "vm/machine.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <iostream>
+#include <sstream>
+
+// Keeps a few strings alive in globals and locals while producing lots of
+// garbage, then prints the survivors.
+const std::string program =
+    "var keep = \"k\"; var i = 0;"
+    "while (i < 20000) {"
+    "  var piece = \"0123456789\" + \"abcdefghij\";"
+    "  var garbage = piece + piece + piece;"
+    "  if (i == 10000) keep = keep + piece;"
+    "  i = i + 1;"
+    "}"
+    "{ var local = keep + \"!\"; var j = 0;"
+    "  while (j < 20000) { var x = local + local; j = j + 1; }"
+    "  print local; }"
+    "print keep;";
+
+const std::string expected =
+    "k0123456789abcdefghij!\nk0123456789abcdefghij\n";
+
+std::string run(bool bytecode) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Scanner scanner = Scanner(program);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+
+  if (bytecode) {
+    Chunk chunk = Compiler().compile(statements);
+    Machine().interpret(chunk);
+  } else {
+    Resolver().resolve(statements);
+    Interpreter().interpret(statements);
+  }
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+int assert_collects(std::string message, GcMode mode, bool bytecode) {
+  Heap &heap = Heap::instance();
+  heap.mode = mode;
+  size_t collections = heap.collections();
+
+  std::string output = run(bytecode);
+
+  if (output != expected) {
+    std::cout << message << ": printed\n" << output << std::endl;
+    return 1;
+  }
+
+  if (heap.collections() == collections) {
+    std::cout << message << ": no collection ran" << std::endl;
+    return 1;
+  }
+
+  if (heap.live_bytes() > 4 * heap.min_threshold) {
+    std::cout << message << ": " << heap.live_bytes() << " bytes still live"
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  Heap &heap = Heap::instance();
+  heap.min_threshold = 64 * 1024;
+  heap.step_bytes = 4 * 1024;
+
+  if (assert_collects("Test full collections", GcMode::FULL, false))
+    return 1;
+
+  if (assert_collects("Test incremental collections", GcMode::INCREMENTAL,
+                      false))
+    return 1;
+
+  if (assert_collects("Test full collections on the bytecode engine",
+                      GcMode::FULL, true))
+    return 1;
+
+  if (assert_collects("Test incremental collections on the bytecode engine",
+                      GcMode::INCREMENTAL, true))
+    return 1;
+
+  return 0;
+}
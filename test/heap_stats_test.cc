@@ -0,0 +1,70 @@
+#include "vm/heap_stats.h"
+#include "vm/interpreter.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <iostream>
+#include <sstream>
+
+// Runs source through the HeapAccountingInterpreter and returns the report.
+std::string run_accounting(std::string source) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+  Resolver resolver = Resolver();
+  resolver.resolve(statements);
+
+  HeapStats::enabled = true;
+  HeapStats::install();
+
+  {
+    HeapAccountingInterpreter interpreter;
+    interpreter.interpret(statements);
+  }
+
+  std::stringstream report;
+  HeapStats::report(report, "at exit");
+  return report.str();
+}
+
+int assert_reports(std::string message, const std::string &report,
+                   const std::string &line) {
+  if (report.find(line) == std::string::npos) {
+    std::cout << message << ": no '" << line << "' in\n"
+              << report << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  // Only the concatenations allocate: the literals were interned by the
+  // Scanner, before accounting started, and numbers are never allocated.
+  std::string report = run_accounting("var s = \"a\";\n"
+                                      "var i = 0;\n"
+                                      "while (i < 5) {\n"
+                                      "  s = s + \"b\";\n"
+                                      "  i = i + 1;\n"
+                                      "}\n"
+                                      "var t = s + \"c\";");
+
+  if (assert_reports("Test allocations are charged to their line", report,
+                     "[heap]   line 4: 5 objects, "))
+    return 1;
+
+  if (assert_reports("Test allocations are charged to their line", report,
+                     "[heap]   line 7: 1 objects, "))
+    return 1;
+
+  if (report.find("line 1:") != std::string::npos ||
+      report.find("line 5:") != std::string::npos ||
+      report.find("outside statements") != std::string::npos) {
+    std::cout << "Test lines that allocate nothing are not listed:\n"
+              << report << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
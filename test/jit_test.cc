@@ -0,0 +1,159 @@
+#include "vm/interpreter.h"
+#include "vm/jit.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <iostream>
+#include <sstream>
+
+vector<shared_ptr<Stmt>> parse(const std::string &source) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+  Resolver().resolve(statements);
+  return statements;
+}
+
+std::string run(const std::string &source, bool jit) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Jit::enabled = jit;
+  Interpreter().interpret(parse(source));
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+// Compiles every loop as soon as it has run once.
+int assert_same_output(std::string message, std::string source) {
+  std::string expected = run(source, false);
+  std::string output = run(source, true);
+
+  if (output != expected) {
+    std::cout << message << ": printed\n"
+              << output << "instead of\n"
+              << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+// The first top level loop, which may be inside a block.
+While *first_loop(const vector<shared_ptr<Stmt>> &statements) {
+  for (const shared_ptr<Stmt> &statement : statements) {
+    if (While *loop = dynamic_cast<While *>(statement.get())) {
+      return loop;
+    }
+
+    if (Block *block = dynamic_cast<Block *>(statement.get())) {
+      if (While *loop = first_loop(block->statements)) {
+        return loop;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+int assert_compiles(std::string message, std::string source, bool expected) {
+  vector<shared_ptr<Stmt>> statements = parse(source);
+  bool compiled = Jit().compile(*first_loop(statements)) != nullptr;
+
+  if (compiled != (expected && Jit::is_supported())) {
+    std::cout << message << ": " << (compiled ? "compiled" : "not compiled")
+              << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  Jit::threshold = 1;
+
+  if (assert_compiles("Test numeric loop",
+                      "var i = 0; var s = 0; while (i < 10) { s = s + i * 2 "
+                      "- -1 / 4; i = i + 1; }",
+                      true))
+    return 1;
+
+  if (assert_compiles("Test locals and branches",
+                      "{ var n = 5; while (n > 0 and !(n == 3)) { var m = n; "
+                      "if (m >= 2 or m != m) n = n - 1; else { n = 0; } } }",
+                      true))
+    return 1;
+
+  if (assert_compiles("Test print is not compiled",
+                      "var i = 0; while (i < 3) { print i; i = i + 1; }",
+                      false))
+    return 1;
+
+  if (assert_compiles("Test strings are not compiled",
+                      "var i = 0; while (i < 3) { i = i + \"a\"; }", false))
+    return 1;
+
+  if (assert_compiles("Test booleans as values are not compiled",
+                      "var i = 0; var b; while (i < 3) { b = i < 2; i = i + "
+                      "1; }",
+                      false))
+    return 1;
+
+  if (assert_same_output("Test accumulator",
+                         "var i = 0; var s = 0; while (i < 1000) { s = s + i "
+                         "* 2; i = i + 1; } print s; print i;"))
+    return 1;
+
+  if (assert_same_output("Test nested loops and locals",
+                         "var total = 0; { var i = 0; while (i < 20) { var j "
+                         "= 0; while (j < i) { var k = j; { var k2 = k * k; "
+                         "total = total + k2; } j = j + 1; } i = i + 1; } "
+                         "print i; } print total;"))
+    return 1;
+
+  if (assert_same_output("Test branches and conditions",
+                         "var i = 0; var a = 0; var b = 0; while (i < 50 and "
+                         "!(a > 1000)) { if (i / 2 - (i - i / 2) == 0 or i "
+                         "<= 3) a = a + i; else { b = b - i; } if (i != 7) "
+                         "{} else b = b * 2; i = i + 1; } print a; print b; "
+                         "print i;"))
+    return 1;
+
+  if (assert_same_output("Test negative zero and NaN",
+                         "var i = 0; var z = 1; var n = 0; var c = 0; while "
+                         "(i < 2) { z = -(z * 0); n = 0 / 0; if (n == n) c = "
+                         "c + 1; if (n != n) c = c + 10; if (n < 1 or n >= "
+                         "1) c = c + 100; i = i + 1; } print z; print c;"))
+    return 1;
+
+  if (assert_same_output("Test assignments are expressions",
+                         "var i = 0; var a = 0; var b = 0; while ((i = i + "
+                         "1) < 10) { a = b = a + i; } print a; print b;"))
+    return 1;
+
+  if (assert_same_output("Test redeclaration and shadowing",
+                         "var x = 10; { var i = 0; while (i < 3) { var x = x "
+                         "+ i; var x = 100; i = i + x; } print x; print i; }"))
+    return 1;
+
+  if (assert_same_output("Test deep expressions",
+                         "var i = 0; var s = 0; while (i < 4) { s = s + (1 + "
+                         "(2 + (3 + (4 + (5 + (6 + (7 + (8 + (9 + (10 + (11 "
+                         "+ (12 + (13 + (14 + (15 + (16 + (17 + i))))))))))))"
+                         "))))); i = i + 1; } print s;"))
+    return 1;
+
+  if (assert_same_output("Test a variable that is not a number",
+                         "var i = 0; var s = \"a\"; while (i < 3) { if (i > "
+                         "5) s = s - 1; i = i + 1; } print s; print i;"))
+    return 1;
+
+  if (assert_same_output("Test runtime errors in unsupported loops",
+                         "var i = 0;\nwhile (i < 3) {\n  print i;\n  i = i + "
+                         "nil;\n}"))
+    return 1;
+
+  return 0;
+}
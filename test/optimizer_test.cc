@@ -0,0 +1,119 @@
+#include "vm/compiler.h"
+#include "vm/interpreter.h"
+#include "vm/machine.h"
+#include "vm/optimizer.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <iostream>
+#include <sstream>
+
+vector<shared_ptr<Stmt>> parse(const std::string &source, int level) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  return Optimizer(level).optimize(parser.parse());
+}
+
+std::string run(const std::string &source, int level, bool bytecode) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+  vector<shared_ptr<Stmt>> statements = parse(source, level);
+
+  if (bytecode) {
+    Chunk chunk = Compiler().compile(statements);
+    Machine().interpret(chunk);
+  } else {
+    Resolver().resolve(statements);
+    Interpreter().interpret(statements);
+  }
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+int assert_same_output(std::string message, std::string source) {
+  std::string expected = run(source, 0, false);
+
+  for (int level = 1; level <= 2; level++) {
+    for (bool bytecode : {false, true}) {
+      std::string output = run(source, level, bytecode);
+
+      if (output != expected) {
+        std::cout << message << ": -O" << level << " printed\n"
+                  << output << "instead of\n"
+                  << expected << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int assert_folded(std::string message, std::string source,
+                  std::string expected) {
+  vector<shared_ptr<Stmt>> statements = parse(source, 1);
+  Print *print = statements.size() == 1
+                     ? dynamic_cast<Print *>(statements[0].get())
+                     : nullptr;
+  Literal *literal =
+      print != nullptr ? dynamic_cast<Literal *>(print->expr.get()) : nullptr;
+
+  if (literal == nullptr || literal->value.to_string() != expected) {
+    std::cout << message << ": not folded to " << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  if (assert_folded("Test arithmetic folding", "print (60 * 60 * 24);",
+                    "86400.000000"))
+    return 1;
+
+  if (assert_folded("Test string folding", "print \"a\" + (\"b\" + \"c\");",
+                    "abc"))
+    return 1;
+
+  if (assert_folded("Test logical folding", "print nil or !false and -(1);",
+                    "-1.000000"))
+    return 1;
+
+  if (parse("if (false) { print 1; } while (false) print 2; {}", 1).size() !=
+      0) {
+    std::cout << "Test dead branches: statements left" << std::endl;
+    return 1;
+  }
+
+  if (assert_same_output("Test errors are not folded",
+                         "print 1;\nprint \"a\" - 1;"))
+    return 1;
+
+  if (assert_same_output("Test negating a string is not folded",
+                         "print 2;\n\nprint -\"a\";"))
+    return 1;
+
+  if (assert_same_output("Test mixed addition is not folded",
+                         "print 1 < 2;\nprint 1 + nil;"))
+    return 1;
+
+  if (assert_same_output("Test branches and loops",
+                         "var a = 1; if (1 > 2) print \"no\"; else { print "
+                         "\"yes\"; } while (a < 3 and true) { { a = a + 1; } "
+                         "print a; } if (a) {} else {}"))
+    return 1;
+
+  if (assert_same_output("Test scopes survive splicing",
+                         "var a = \"global\"; { { print a; } var a = "
+                         "\"local\"; { { print a; } } } { 1 + 2; } print a;"))
+    return 1;
+
+  if (assert_same_output("Test side effects in dropped conditions",
+                         "var a = 1; if (a = 2) {} print a; while (false) a = "
+                         "3; print a; print false and (a = 4); print a;"))
+    return 1;
+
+  return 0;
+}
@@ -1,12 +1,14 @@
+#include "vm/parser.h"
 #include "vm/scanner.h"
 #include "vm/token.h"
 #include <memory>
 
 int assert_tokens(std::string message, std::string source,
                   std::vector<TokenType> types,
-                  std::vector<std::shared_ptr<Object>> values) {
+                  std::vector<Value> values) {
   Scanner scanner = Scanner(source);
   std::vector<Token> tokens = scanner.scan_tokens();
+  const std::vector<Value> &literals = scanner.literals();
   bool keep_going = true;
   int i = 0;
 
@@ -31,7 +33,7 @@ int assert_tokens(std::string message, std::string source,
   i = 0;
 
   while (i < values.size() && keep_going) {
-    if (values[i]->to_string() != tokens[i].literal->to_string()) {
+    if (values[i].to_string() != literals[tokens[i].literal].to_string()) {
       std::cout << "Token values are not equal" << std::endl;
       keep_going = false;
     }
@@ -45,15 +47,58 @@ int assert_tokens(std::string message, std::string source,
   return 0;
 }
 
+int assert_lines(std::string message, std::string source,
+                 std::vector<uint32_t> lines) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (i >= tokens.size() || tokens[i].line != lines[i]) {
+      std::cout << message << ": token " << i << " is on the wrong line"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int assert_statement_lines(std::string message, std::string source,
+                           std::vector<uint32_t> lines) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (i >= statements.size() || statements[i]->line != lines[i]) {
+      std::cout << message << ": statement " << i << " is on the wrong line"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
 int main() {
   std::vector<TokenType> types;
-  std::vector<std::shared_ptr<Object>> values;
+  std::vector<Value> values;
 
   types = {TokenType::STRING};
-  values = {std::make_shared<String>("a string")};
+  values = {Value(new String("a string"))};
   if (assert_tokens("Test parsing strings", "\"a string\"", types, values))
     return 1;
 
+  Scanner scanner = Scanner("\"key\" \"key\" \"other\"");
+  scanner.scan_tokens();
+  const std::vector<Value> &strings = scanner.literals();
+  if (strings[1].as_string() != strings[2].as_string() ||
+      strings[1].as_string() == strings[3].as_string()) {
+    std::cout << "Test string literals are interned" << std::endl;
+    return 1;
+  }
+
   types = {TokenType::CLASS, TokenType::IDENTIFIER, TokenType::LEFT_BRACE,
            TokenType::RIGHT_BRACE};
   values = {};
@@ -62,7 +107,7 @@ int main() {
     return 1;
 
   types = {TokenType::NUMBER};
-  values = {std::make_shared<Number>(5.5)};
+  values = {Value(5.5)};
   if (assert_tokens("Test parsing numbers", "5.5", types, values))
     return 1;
 
@@ -71,5 +116,43 @@ int main() {
   if (assert_tokens("Test comments", "// some comment", types, values))
     return 1;
 
+  types = {TokenType::AND,   TokenType::CLASS,  TokenType::ELSE,
+           TokenType::FALSE, TokenType::FOR,    TokenType::FUN,
+           TokenType::IF,    TokenType::NIL,    TokenType::OR,
+           TokenType::PRINT, TokenType::RETURN, TokenType::SUPER,
+           TokenType::THIS,  TokenType::TRUE,   TokenType::VAR,
+           TokenType::WHILE};
+  if (assert_tokens("Test keywords",
+                    "and class else false for fun if nil or print return "
+                    "super this true var while",
+                    types, values))
+    return 1;
+
+  types = {TokenType::IDENTIFIER, TokenType::IDENTIFIER,
+           TokenType::IDENTIFIER, TokenType::IDENTIFIER,
+           TokenType::IDENTIFIER, TokenType::IDENTIFIER};
+  if (assert_tokens("Test identifiers close to keywords",
+                    "andy fo whilf Print _ a_very_long_identifier_name_42",
+                    types, values))
+    return 1;
+
+  types = {TokenType::VAR, TokenType::IDENTIFIER, TokenType::SEMICOLON};
+  if (assert_tokens("Test nested block comments",
+                    "/* outer /* inner */ still a comment **/ var x;", types,
+                    values))
+    return 1;
+
+  if (assert_lines("Test line numbers across blanks, strings and comments",
+                   "a                    \n\n\t\r  b \"multi\nline\nstring "
+                   "longer than sixteen\" /* one\ntwo\n */ c // d\ne",
+                   {1, 3, 5, 7, 8}))
+    return 1;
+
+  if (assert_statement_lines("Test statement lines",
+                             "var a = 1;\n\nprint a;\nfor (var i = 0;\n"
+                             "     i < 2; i = i + 1)\n  print i;\n{\n}",
+                             {1, 3, 4, 7}))
+    return 1;
+
   return 0;
 }
@@ -0,0 +1,61 @@
+#include "vm/vm.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+int assert_sampled(std::string message, const std::string &folded,
+                   const std::string &frame) {
+  if (folded.find(frame) == std::string::npos) {
+    std::cout << message << ": no '" << frame << "' in\n"
+              << folded << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  char script[] = "/tmp/lox_profile_testXXXXXX";
+  close(mkstemp(script));
+  std::string profile = std::string(script) + ".folded";
+
+  // Hot enough for the Jit, which would run the loop as one native call.
+  std::ofstream(script) << "var i = 0; var a = 0; var b = 0;\n"
+                           "while (i < 2000000) {\n"
+                           "  a = a + i;\n"
+                           "  b = b + a * 2;\n"
+                           "  i = i + 1;\n"
+                           "}\n";
+
+  std::string flag = "--profile=" + profile;
+  char *argv[] = {const_cast<char *>("lox"), const_cast<char *>(flag.c_str()),
+                  script, nullptr};
+
+  std::stringstream report;
+  std::streambuf *previous = std::cerr.rdbuf(report.rdbuf());
+  int status = Vm::execute(3, argv);
+  std::cerr.rdbuf(previous);
+
+  std::ifstream in(profile);
+  std::string folded((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+
+  if (status != 0) {
+    std::cout << "Test the profiled script runs: exited with " << status
+              << std::endl;
+    return 1;
+  }
+
+  if (assert_sampled("Test a hot loop is sampled line by line", folded,
+                     "expression (line 3)") ||
+      assert_sampled("Test a hot loop is sampled line by line", folded,
+                     "expression (line 4)"))
+    return 1;
+
+  remove(script);
+  remove(profile.c_str());
+  return 0;
+}
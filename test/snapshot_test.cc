@@ -0,0 +1,116 @@
+#include "vm/interpreter.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include "vm/snapshot.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+// Defines globals of every type, two sharing one string, and one that is
+// only ever declared inside a block.
+const std::string prelude =
+    "var number = 2.5; var text = \"pre\" + \"lude\"; var same = text;\n"
+    "var yes = true; var no = false; var nothing = nil;\n"
+    "{ var hidden = 1; }\n"
+    "var counter = 0; while (counter < 10) counter = counter + 1;";
+
+const std::string script =
+    "print number * counter; print text + \"!\"; print same == text;\n"
+    "print yes and !no; print nothing;\n"
+    "var number = 0; print number;";
+
+void run(Interpreter &interpreter, const std::string &source) {
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+  Resolver().resolve(statements);
+  interpreter.interpret(statements);
+}
+
+std::string capture(const std::string &path, bool restore) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Interpreter interpreter;
+
+  if (restore) {
+    Snapshot::open(path)->restore(interpreter.global_environment());
+  } else {
+    run(interpreter, prelude);
+  }
+
+  run(interpreter, script);
+
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+int assert_restores(std::string message, const std::string &path) {
+  Interpreter interpreter;
+  run(interpreter, prelude);
+
+  if (!Snapshot::write(path, interpreter.global_environment())) {
+    std::cout << message << ": could not write" << std::endl;
+    return 1;
+  }
+
+  if (Snapshot::open(path) == nullptr) {
+    std::cout << message << ": could not open" << std::endl;
+    return 1;
+  }
+
+  std::string expected = capture(path, false);
+  std::string output = capture(path, true);
+
+  if (output != expected) {
+    std::cout << message << ": printed\n"
+              << output << "instead of\n"
+              << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int assert_rejected(std::string message, const std::string &path) {
+  if (Snapshot::open(path) != nullptr) {
+    std::cout << message << ": opened a damaged snapshot" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  char path[] = "/tmp/lox_snapshot_testXXXXXX";
+  close(mkstemp(path));
+
+  if (assert_restores("Test restoring a prelude's globals", path))
+    return 1;
+
+  std::ifstream in(path, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  in.close();
+
+  // Points the first entry's name, right after the header, past the end.
+  contents[16] = '\x7f';
+  std::ofstream(path, std::ios::binary)
+      .write(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+  if (assert_rejected("Test a damaged snapshot is rejected", path))
+    return 1;
+
+  std::ofstream(path, std::ios::binary).write("LOXS", 4);
+
+  if (assert_rejected("Test a truncated snapshot is rejected", path))
+    return 1;
+
+  remove(path);
+  return 0;
+}
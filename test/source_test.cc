@@ -0,0 +1,67 @@
+#include "vm/scanner.h"
+#include "vm/source.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+std::string write_file(std::string contents) {
+  char path[] = "/tmp/source_testXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  return path;
+}
+
+int assert_source(std::string message, std::string contents, bool mapped) {
+  std::string path = write_file(contents);
+  std::unique_ptr<Source> source = Source::open(path);
+  std::remove(path.c_str());
+
+  if (source == nullptr) {
+    std::cout << message << ": could not open " << path << std::endl;
+    return 1;
+  }
+
+  if (source->view() != contents) {
+    std::cout << message << ": contents differ" << std::endl;
+    return 1;
+  }
+
+  if (source->is_mapped() != mapped) {
+    std::cout << message << ": unexpected loading strategy" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  if (assert_source("Test newlines are kept", "var a = 1;\n// c\nprint a;\n",
+                    true))
+    return 1;
+
+  if (assert_source("Test empty file", "", false))
+    return 1;
+
+  if (Source::open("/tmp/source_test_missing") != nullptr) {
+    std::cout << "Test missing file: opened" << std::endl;
+    return 1;
+  }
+
+  // Line numbers only work if the loader keeps the newlines.
+  std::string path = write_file("var a;\n\n// comment\nprint a;");
+  std::unique_ptr<Source> source = Source::open(path);
+  std::remove(path.c_str());
+  Scanner scanner = Scanner(source->view());
+  std::vector<Token> tokens = scanner.scan_tokens();
+
+  if (tokens.size() != 7 || tokens[3].line != 4) {
+    std::cout << "Test line numbers: print is not on line 4" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
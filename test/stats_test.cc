@@ -0,0 +1,61 @@
+#include "vm/interpreter.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include "vm/stats.h"
+#include <iostream>
+#include <sstream>
+
+void run_counting(std::string source) {
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+
+  Scanner scanner = Scanner(source);
+  std::vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(tokens, scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+  Resolver resolver = Resolver();
+  resolver.resolve(statements);
+  CountingInterpreter interpreter = CountingInterpreter();
+  interpreter.interpret(statements);
+
+  std::cout.rdbuf(previous);
+}
+
+int assert_count(std::string message, size_t count, size_t expected) {
+  if (count != expected) {
+    std::cout << message << ": counted " << count << " instead of "
+              << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+int main() {
+  Stats::enabled = true;
+
+  // Each of the three iterations runs two blocks, the var and the
+  // assignment; b is a local read from one block further in.
+  run_counting("var a = 1;\n"
+               "var i = 0;\n"
+               "while (i < 3) { var b = a; { i = i + b; } }\n"
+               "print i;");
+
+  if (assert_count("Test statements executed", Stats::statements, 16))
+    return 1;
+
+  if (assert_count("Test global lookups", Stats::global_lookups, 14))
+    return 1;
+
+  if (assert_count("Test local lookups", Stats::local_lookups, 3))
+    return 1;
+
+  if (assert_count("Test scope hops", Stats::scope_hops, 3))
+    return 1;
+
+  if (assert_count("Test scopes entered", Stats::scopes, 6))
+    return 1;
+
+  return 0;
+}
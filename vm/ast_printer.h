@@ -17,34 +17,32 @@ public:
     }
   }
 
-  String visitBinaryExpr(Binary expr) {
+  String visitBinaryExpr(Binary &expr) {
     vector<shared_ptr<Expr>> exprs = {expr.left, expr.right};
-    return String(parenthesize(expr.op.lexeme, exprs));
+    return String(parenthesize(string(expr.op.lexeme()), exprs));
   }
 
-  String visitGroupingExpr(Grouping expr) {
+  String visitGroupingExpr(Grouping &expr) {
     vector<shared_ptr<Expr>> exprs = {expr.expression};
     return String(parenthesize("group", exprs));
   }
 
-  String visitLiteralExpr(Literal expr) {
-    if (expr.value == nullptr) {
-      return String("nil");
-    }
-
-    return String(expr.value->to_string());
+  String visitLiteralExpr(Literal &expr) {
+    return String(expr.value.to_string());
   }
 
-  String visitUnaryExpr(Unary expr) {
+  String visitUnaryExpr(Unary &expr) {
     vector<shared_ptr<Expr>> exprs = {expr.right};
-    return String(parenthesize(expr.op.lexeme, exprs));
+    return String(parenthesize(string(expr.op.lexeme()), exprs));
   }
 
-  String visitVariableExpr(Variable expr) { return String(expr.name.lexeme); }
+  String visitVariableExpr(Variable &expr) {
+    return String(string(expr.name.lexeme()));
+  }
 
-  String visitAssignExpr(Assign expr) {
+  String visitAssignExpr(Assign &expr) {
     vector<shared_ptr<Expr>> exprs = {expr.value};
-    return String(parenthesize(expr.name.lexeme, exprs));
+    return String(parenthesize(string(expr.name.lexeme()), exprs));
   }
 
 private:
@@ -0,0 +1,164 @@
+#include "vm/batch.h"
+#include "literals/heap.h"
+#include "vm/session.h"
+#include "vm/vm.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+bool Batch::scripts(const string &target, vector<string> &paths) {
+  error_code error;
+
+  if (filesystem::is_directory(target, error)) {
+    for (const auto &entry : filesystem::directory_iterator(target, error)) {
+      if (entry.path().extension() == ".lox" &&
+          !entry.is_directory(error)) {
+        paths.push_back(entry.path().string());
+      }
+    }
+
+    sort(paths.begin(), paths.end());
+    return !error;
+  }
+
+  ifstream manifest(target);
+
+  if (!manifest) {
+    return false;
+  }
+
+  filesystem::path base = filesystem::path(target).parent_path();
+  string line;
+
+  while (getline(manifest, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    paths.push_back((base / line).string());
+  }
+
+  return true;
+}
+
+int Batch::run(const vector<string> &paths, int jobs, ostream &out) {
+  struct Result {
+    bool done = false;
+    int status = 0;
+    string output;
+    string errors;
+  };
+
+  vector<Result> results(paths.size());
+  atomic<size_t> next(0);
+  mutex lock;
+  condition_variable finished;
+  // Workers start with the collector settings of the calling thread's heap.
+  const Heap &settings = Heap::instance();
+
+  auto work = [&]() {
+    Heap &heap = Heap::instance();
+    heap.mode = settings.mode;
+    heap.budget_us = settings.budget_us;
+
+    for (size_t i = next++; i < paths.size(); i = next++) {
+      ostringstream output;
+      ostringstream errors;
+      Session session(output, errors);
+      int status;
+
+      {
+        Session::Scope scope(session);
+        string path = paths[i];
+        status = Vm::runFile(&path[0]);
+      }
+
+      lock_guard<mutex> guard(lock);
+      results[i] = {true, status, output.str(), errors.str()};
+      finished.notify_one();
+    }
+  };
+
+  vector<thread> workers;
+  size_t count = min(static_cast<size_t>(max(jobs, 1)), paths.size());
+
+  for (size_t i = 0; i < count; i++) {
+    workers.emplace_back(work);
+  }
+
+  int status = 0;
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    Result result;
+
+    {
+      unique_lock<mutex> guard(lock);
+      finished.wait(guard, [&]() { return results[i].done; });
+      result = move(results[i]);
+    }
+
+    write_result(out, paths[i], result.status, result.output, result.errors);
+    status |= result.status != 0;
+  }
+
+  for (thread &worker : workers) {
+    worker.join();
+  }
+
+  return status;
+}
+
+void Batch::write_result(ostream &out, const string &path, int status,
+                         const string &output, const string &errors) {
+  out << "{\"script\":";
+  write_string(out, path);
+  out << ",\"exit\":" << status << ",\"stdout\":";
+  write_string(out, output);
+  out << ",\"stderr\":";
+  write_string(out, errors);
+  out << "}" << endl;
+}
+
+void Batch::write_string(ostream &out, const string &text) {
+  out << '"';
+
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      out << "\\\"";
+      break;
+    case '\\':
+      out << "\\\\";
+      break;
+    case '\n':
+      out << "\\n";
+      break;
+    case '\r':
+      out << "\\r";
+      break;
+    case '\t':
+      out << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[7];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out << escaped;
+      } else {
+        out << c;
+      }
+    }
+  }
+
+  out << '"';
+}
@@ -0,0 +1,41 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Runs many scripts on a pool of threads, behind --batch.
+//
+// Every script runs as if on its own command line, with the same flags, but
+// in a Session of its own on whichever worker thread picks it up. Its output
+// and errors are captured rather than printed, and its exit code keeps the
+// meaning it has for a single script: 65 after a syntax error, 70 after a
+// runtime error and 74 when it cannot be read. Each worker has its own Heap
+// and string table, so scripts share nothing but the immutable flags and an
+// optional --snapshot-in, which is only ever read.
+//
+// The results are written as they complete but in input order, one JSON
+// object per line:
+//
+//   {"script":"a.lox","exit":0,"stdout":"1\n","stderr":""}
+class Batch final {
+public:
+  // The scripts named by target: every .lox file in it, by name, when it is
+  // a directory, or else the lines of it, each a path relative to it. Blank
+  // lines and lines starting with # are skipped. Returns false when target
+  // cannot be read.
+  static bool scripts(const string &target, vector<string> &paths);
+  // Runs paths on jobs threads and writes their results to out. Returns 0
+  // when every script exited with 0, and 1 otherwise.
+  static int run(const vector<string> &paths, int jobs, ostream &out);
+
+private:
+  static void write_result(ostream &out, const string &path, int status,
+                           const string &output, const string &errors);
+  static void write_string(ostream &out, const string &text);
+};
+
+#endif
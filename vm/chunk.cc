@@ -0,0 +1,45 @@
+#include "vm/chunk.h"
+
+void Chunk::write(uint8_t byte, int line) {
+  code.push_back(byte);
+  lines.push_back(line);
+}
+
+void Chunk::write(OpCode op, int line) {
+  write(static_cast<uint8_t>(op), line);
+}
+
+void Chunk::write_u16(uint16_t value, int line) {
+  write(static_cast<uint8_t>(value & 0xff), line);
+  write(static_cast<uint8_t>(value >> 8), line);
+}
+
+void Chunk::write_u32(uint32_t value, int line) {
+  write_u16(static_cast<uint16_t>(value & 0xffff), line);
+  write_u16(static_cast<uint16_t>(value >> 16), line);
+}
+
+void Chunk::patch_u32(size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    code[offset + i] = static_cast<uint8_t>((value >> (8 * i)) & 0xff);
+  }
+}
+
+uint16_t Chunk::read_u16(size_t offset) const {
+  return static_cast<uint16_t>(code[offset] | (code[offset + 1] << 8));
+}
+
+uint32_t Chunk::read_u32(size_t offset) const {
+  return static_cast<uint32_t>(read_u16(offset)) |
+         (static_cast<uint32_t>(read_u16(offset + 2)) << 16);
+}
+
+uint32_t Chunk::add_constant(Value value) {
+  constants.push_back(value);
+  return static_cast<uint32_t>(constants.size() - 1);
+}
+
+uint32_t Chunk::add_name(const string &name) {
+  names.push_back(name);
+  return static_cast<uint32_t>(names.size() - 1);
+}
@@ -0,0 +1,66 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "literals/value.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+enum class OpCode : uint8_t {
+  CONSTANT,
+  NIL,
+  POP,
+  GET_LOCAL,
+  SET_LOCAL,
+  GET_GLOBAL,
+  DEFINE_GLOBAL,
+  SET_GLOBAL,
+  EQUAL,
+  NOT_EQUAL,
+  GREATER,
+  GREATER_EQUAL,
+  LESS,
+  LESS_EQUAL,
+  ADD,
+  SUBTRACT,
+  MULTIPLY,
+  DIVIDE,
+  NOT,
+  NEGATE,
+  PRINT,
+  JUMP,
+  JUMP_IF_FALSE,
+  LOOP,
+  RETURN
+};
+
+// A compiled program: a flat stream of opcodes and their operands, the
+// constant pool referenced by CONSTANT, the global names referenced by the
+// *_GLOBAL instructions and the source line of every byte for error reporting.
+//
+// Operands are stored little endian right after their opcode. Locals are
+// addressed with 16 bits, constants, names and jump offsets with 32 bits.
+class Chunk final {
+public:
+  void write(uint8_t byte, int line);
+  void write(OpCode op, int line);
+  void write_u16(uint16_t value, int line);
+  void write_u32(uint32_t value, int line);
+  void patch_u32(size_t offset, uint32_t value);
+
+  uint16_t read_u16(size_t offset) const;
+  uint32_t read_u32(size_t offset) const;
+
+  uint32_t add_constant(Value value);
+  uint32_t add_name(const string &name);
+
+  vector<uint8_t> code;
+  vector<int> lines;
+  vector<Value> constants;
+  vector<string> names;
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include "vm/closure_compiler.h"
+
+ClosureCompiler::ClosureCompiler() {
+  Heap::instance().add_roots(&globals);
+  Heap::instance().add_roots(&locals);
+}
+
+ClosureCompiler::~ClosureCompiler() {
+  Heap::instance().remove_roots(&globals);
+  Heap::instance().remove_roots(&locals);
+}
+
+void ClosureCompiler::interpret(const vector<shared_ptr<Stmt>> &statements) {
+  StmtFn program = compile_sequence(statements);
+
+  // The closures index straight into these, so they are sized once up front
+  // and never reallocate while the program runs.
+  globals.resize(global_slots.size());
+  defined.resize(global_slots.size());
+  locals.resize(max_locals);
+
+  try {
+    program();
+  } catch (RuntimeError &error) {
+    Vm::runtime_error(error.op, error.message);
+  }
+}
+
+ClosureCompiler::ExprFn
+ClosureCompiler::compile(const shared_ptr<Expr> &expr) {
+  expr->accept(this);
+  return std::move(expr_result);
+}
+
+ClosureCompiler::StmtFn
+ClosureCompiler::compile(const shared_ptr<Stmt> &stmt) {
+  stmt->accept(this);
+  return std::move(stmt_result);
+}
+
+ClosureCompiler::StmtFn
+ClosureCompiler::compile_sequence(const vector<shared_ptr<Stmt>> &statements) {
+  vector<StmtFn> body;
+  body.reserve(statements.size());
+
+  for (const shared_ptr<Stmt> &statement : statements) {
+    body.push_back(compile(statement));
+  }
+
+  // Expression temporaries never outlive a statement, so every live value is
+  // in globals or locals between two statements.
+  return [body = std::move(body)]() {
+    for (const StmtFn &statement : body) {
+      Heap::instance().safepoint();
+      statement();
+    }
+  };
+}
+
+int ClosureCompiler::resolve_local(string_view name) {
+  for (int i = static_cast<int>(scope.size()) - 1; i >= 0; i--) {
+    if (scope[i].name == name)
+      return i;
+  }
+
+  return -1;
+}
+
+int ClosureCompiler::global_slot(string_view name) {
+  auto existing = global_slots.find(name);
+
+  if (existing != global_slots.end()) {
+    return existing->second;
+  }
+
+  int slot = static_cast<int>(global_slots.size());
+  global_slots.insert(pair<string, int>(string(name), slot));
+  return slot;
+}
+
+template <class Operation>
+ClosureCompiler::ExprFn ClosureCompiler::numeric(ExprFn left, ExprFn right,
+                                                 Token op,
+                                                 Operation operation) {
+  return [left = std::move(left), right = std::move(right), op, operation]() {
+    Value a = left();
+    Value b = right();
+
+    if (!a.is_number() || !b.is_number()) {
+      throw RuntimeError(op, "Operands must be numbers.");
+    }
+
+    return Value(operation(a.as_number(), b.as_number()));
+  };
+}
+
+void ClosureCompiler::visitBinaryExpr(Binary &expr) {
+  ExprFn left = compile(expr.left);
+  ExprFn right = compile(expr.right);
+  Token op = expr.op;
+
+  switch (op.type) {
+  case TokenType::MINUS:
+    expr_result = numeric(std::move(left), std::move(right), op, minus<>());
+    return;
+  case TokenType::SLASH:
+    expr_result = numeric(std::move(left), std::move(right), op, divides<>());
+    return;
+  case TokenType::STAR:
+    expr_result =
+        numeric(std::move(left), std::move(right), op, multiplies<>());
+    return;
+  case TokenType::GREATER:
+    expr_result = numeric(std::move(left), std::move(right), op, greater<>());
+    return;
+  case TokenType::GREATER_EQUAL:
+    expr_result =
+        numeric(std::move(left), std::move(right), op, greater_equal<>());
+    return;
+  case TokenType::LESS:
+    expr_result = numeric(std::move(left), std::move(right), op, less<>());
+    return;
+  case TokenType::LESS_EQUAL:
+    expr_result =
+        numeric(std::move(left), std::move(right), op, less_equal<>());
+    return;
+  case TokenType::PLUS:
+    expr_result = [left = std::move(left), right = std::move(right), op]() {
+      Value a = left();
+      Value b = right();
+
+      if (a.is_number() && b.is_number()) {
+        return Value(a.as_number() + b.as_number());
+      }
+
+      if (a.is_string() && b.is_string()) {
+        return Value(String::concat(*a.as_string(), *b.as_string()));
+      }
+
+      throw RuntimeError(op, "Operands must be two numbers or two strings.");
+    };
+    return;
+  case TokenType::EQUAL_EQUAL:
+    expr_result = [left = std::move(left), right = std::move(right)]() {
+      Value a = left();
+      return Value(a == right());
+    };
+    return;
+  case TokenType::BANG_EQUAL:
+    expr_result = [left = std::move(left), right = std::move(right)]() {
+      Value a = left();
+      return Value(!(a == right()));
+    };
+    return;
+  default:
+    expr_result = []() { return Value(); };
+    return;
+  }
+}
+
+void ClosureCompiler::visitGroupingExpr(Grouping &expr) {
+  expr_result = compile(expr.expression);
+}
+
+void ClosureCompiler::visitLiteralExpr(Literal &expr) {
+  expr_result = [value = expr.value]() { return value; };
+}
+
+void ClosureCompiler::visitUnaryExpr(Unary &expr) {
+  ExprFn right = compile(expr.right);
+  Token op = expr.op;
+
+  if (op.type == TokenType::BANG) {
+    expr_result = [right = std::move(right)]() {
+      return Value(!right().is_truthy());
+    };
+    return;
+  }
+
+  expr_result = [right = std::move(right), op]() {
+    Value value = right();
+
+    if (!value.is_number()) {
+      throw RuntimeError(op, "Operand must be a number.");
+    }
+
+    return Value(-value.as_number());
+  };
+}
+
+void ClosureCompiler::visitVariableExpr(Variable &expr) {
+  int slot = resolve_local(expr.name.lexeme());
+
+  if (slot != -1) {
+    expr_result = [this, slot]() { return locals[slot]; };
+    return;
+  }
+
+  Token name = expr.name;
+  slot = global_slot(name.lexeme());
+  expr_result = [this, slot, name]() {
+    if (!defined[slot]) {
+      throw RuntimeError(name, "Undefined variable '" +
+                                   std::string(name.lexeme()) + "'.");
+    }
+
+    return globals[slot];
+  };
+}
+
+void ClosureCompiler::visitAssignExpr(Assign &expr) {
+  ExprFn value = compile(expr.value);
+  int slot = resolve_local(expr.name.lexeme());
+
+  if (slot != -1) {
+    expr_result = [this, slot, value = std::move(value)]() {
+      return locals[slot] = value();
+    };
+    return;
+  }
+
+  Token name = expr.name;
+  slot = global_slot(name.lexeme());
+  expr_result = [this, slot, name, value = std::move(value)]() {
+    Value result = value();
+
+    if (!defined[slot]) {
+      throw RuntimeError(name, "Undefined variable '" +
+                                   std::string(name.lexeme()) + "'.");
+    }
+
+    return globals[slot] = result;
+  };
+}
+
+void ClosureCompiler::visitLogicalExpr(Logical &expr) {
+  ExprFn left = compile(expr.left);
+  ExprFn right = compile(expr.right);
+
+  if (expr.op.type == TokenType::OR) {
+    expr_result = [left = std::move(left), right = std::move(right)]() {
+      Value value = left();
+      return value.is_truthy() ? value : right();
+    };
+  } else {
+    expr_result = [left = std::move(left), right = std::move(right)]() {
+      Value value = left();
+      return !value.is_truthy() ? value : right();
+    };
+  }
+}
+
+void ClosureCompiler::visitExpressionStmt(Expression &stmt) {
+  ExprFn expr = compile(stmt.expr);
+  stmt_result = [expr = std::move(expr)]() { expr(); };
+}
+
+void ClosureCompiler::visitPrintStmt(Print &stmt) {
+  ExprFn expr = compile(stmt.expr);
+  stmt_result = [expr = std::move(expr)]() {
+    Session::current().out << expr().to_string() << endl;
+  };
+}
+
+void ClosureCompiler::visitVarStmt(Var &stmt) {
+  ExprFn initializer = stmt.initializer != nullptr
+                           ? compile(stmt.initializer)
+                           : []() { return Value(); };
+
+  // The first definition of a global wins, as in Environment::define.
+  if (scope_depth == 0) {
+    int slot = global_slot(stmt.name.lexeme());
+    stmt_result = [this, slot, initializer = std::move(initializer)]() {
+      Value value = initializer();
+
+      if (!defined[slot]) {
+        globals[slot] = value;
+        defined[slot] = true;
+      }
+    };
+    return;
+  }
+
+  // Redeclaring a variable in the same block evaluates the initializer and
+  // drops it.
+  for (auto local = scope.rbegin();
+       local != scope.rend() && local->depth == scope_depth; local++) {
+    if (local->name == stmt.name.lexeme()) {
+      stmt_result = [initializer = std::move(initializer)]() { initializer(); };
+      return;
+    }
+  }
+
+  int slot = static_cast<int>(scope.size());
+  scope.push_back(Local{stmt.name.lexeme(), scope_depth});
+  max_locals = max(max_locals, scope.size());
+  stmt_result = [this, slot, initializer = std::move(initializer)]() {
+    locals[slot] = initializer();
+  };
+}
+
+void ClosureCompiler::visitBlockStmt(Block &stmt) {
+  scope_depth++;
+  stmt_result = compile_sequence(stmt.statements);
+  scope_depth--;
+
+  while (!scope.empty() && scope.back().depth > scope_depth) {
+    scope.pop_back();
+  }
+}
+
+void ClosureCompiler::visitIfStmt(If &stmt) {
+  ExprFn condition = compile(stmt.condition);
+  StmtFn then_branch = compile(stmt.then_branch);
+
+  if (stmt.else_branch == nullptr) {
+    stmt_result = [condition = std::move(condition),
+                   then_branch = std::move(then_branch)]() {
+      if (condition().is_truthy()) {
+        then_branch();
+      }
+    };
+    return;
+  }
+
+  StmtFn else_branch = compile(stmt.else_branch);
+  stmt_result = [condition = std::move(condition),
+                 then_branch = std::move(then_branch),
+                 else_branch = std::move(else_branch)]() {
+    if (condition().is_truthy()) {
+      then_branch();
+    } else {
+      else_branch();
+    }
+  };
+}
+
+void ClosureCompiler::visitWhileStmt(While &stmt) {
+  ExprFn condition = compile(stmt.condition);
+  StmtFn body = compile(stmt.body);
+
+  stmt_result = [condition = std::move(condition), body = std::move(body)]() {
+    while (condition().is_truthy()) {
+      Heap::instance().safepoint();
+      body();
+    }
+  };
+}
@@ -0,0 +1,82 @@
+#ifndef CLOSURE_COMPILER_H
+#define CLOSURE_COMPILER_H
+
+#include "literals/heap.h"
+#include "literals/value.h"
+#include "vm/errors.h"
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include "vm/token.h"
+#include "vm/vm.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Execution engine that walks the AST once and lowers every node to a C++
+// closure capturing its operand closures, so running the program is a chain
+// of direct calls with no visitor dispatch and no switch on operator types.
+// Like the Compiler, block locals are resolved to fixed slots at compile time
+// and globals to indexes into a dense table; runtime errors are the same as
+// the Interpreter's.
+class ClosureCompiler final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  ClosureCompiler();
+  ~ClosureCompiler();
+  ClosureCompiler(const ClosureCompiler &) = delete;
+  ClosureCompiler &operator=(const ClosureCompiler &) = delete;
+
+  void interpret(const vector<shared_ptr<Stmt>> &statements);
+
+  void visitBinaryExpr(Binary &expr);
+  void visitGroupingExpr(Grouping &expr);
+  void visitLiteralExpr(Literal &expr);
+  void visitUnaryExpr(Unary &expr);
+  void visitVariableExpr(Variable &expr);
+  void visitAssignExpr(Assign &expr);
+  void visitLogicalExpr(Logical &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  using ExprFn = function<Value()>;
+  using StmtFn = function<void()>;
+
+  struct Local {
+    string_view name;
+    int depth;
+  };
+
+  // Runtime state read and written by the closures.
+  vector<Value> globals;
+  vector<bool> defined;
+  vector<Value> locals;
+
+  // Compile time state.
+  vector<Local> scope;
+  map<string, int, less<>> global_slots;
+  size_t max_locals = 0;
+  int scope_depth = 0;
+  ExprFn expr_result;
+  StmtFn stmt_result;
+
+  ExprFn compile(const shared_ptr<Expr> &expr);
+  StmtFn compile(const shared_ptr<Stmt> &stmt);
+  StmtFn compile_sequence(const vector<shared_ptr<Stmt>> &statements);
+  int resolve_local(string_view name);
+  int global_slot(string_view name);
+  template <class Operation>
+  static ExprFn numeric(ExprFn left, ExprFn right, Token op,
+                        Operation operation);
+};
+
+#endif
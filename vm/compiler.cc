@@ -0,0 +1,273 @@
+#include "vm/compiler.h"
+
+Chunk Compiler::compile(vector<shared_ptr<Stmt>> statements) {
+  for (shared_ptr<Stmt> statement : statements) {
+    compile(statement);
+  }
+
+  emit(OpCode::RETURN);
+  return chunk;
+}
+
+void Compiler::compile(shared_ptr<Expr> expr) { expr->accept(this); }
+
+void Compiler::compile(shared_ptr<Stmt> stmt) { stmt->accept(this); }
+
+void Compiler::visitLiteralExpr(Literal &expr) {
+  if (expr.value.is_nil()) {
+    emit(OpCode::NIL);
+    return;
+  }
+
+  emit_u32(OpCode::CONSTANT, chunk.add_constant(expr.value), line);
+}
+
+void Compiler::visitGroupingExpr(Grouping &expr) { compile(expr.expression); }
+
+void Compiler::visitUnaryExpr(Unary &expr) {
+  line = expr.op.line;
+  compile(expr.right);
+
+  switch (expr.op.type) {
+  case TokenType::BANG:
+    emit(OpCode::NOT, expr.op.line);
+    break;
+  case TokenType::MINUS:
+    emit(OpCode::NEGATE, expr.op.line);
+    break;
+  default:
+    break;
+  }
+}
+
+void Compiler::visitBinaryExpr(Binary &expr) {
+  line = expr.op.line;
+  compile(expr.left);
+  compile(expr.right);
+
+  switch (expr.op.type) {
+  case TokenType::MINUS:
+    emit(OpCode::SUBTRACT, expr.op.line);
+    break;
+  case TokenType::SLASH:
+    emit(OpCode::DIVIDE, expr.op.line);
+    break;
+  case TokenType::STAR:
+    emit(OpCode::MULTIPLY, expr.op.line);
+    break;
+  case TokenType::PLUS:
+    emit(OpCode::ADD, expr.op.line);
+    break;
+  case TokenType::GREATER:
+    emit(OpCode::GREATER, expr.op.line);
+    break;
+  case TokenType::GREATER_EQUAL:
+    emit(OpCode::GREATER_EQUAL, expr.op.line);
+    break;
+  case TokenType::LESS:
+    emit(OpCode::LESS, expr.op.line);
+    break;
+  case TokenType::LESS_EQUAL:
+    emit(OpCode::LESS_EQUAL, expr.op.line);
+    break;
+  case TokenType::BANG_EQUAL:
+    emit(OpCode::NOT_EQUAL, expr.op.line);
+    break;
+  case TokenType::EQUAL_EQUAL:
+    emit(OpCode::EQUAL, expr.op.line);
+    break;
+  default:
+    break;
+  }
+}
+
+void Compiler::visitVariableExpr(Variable &expr) {
+  line = expr.name.line;
+  int slot = resolve_local(expr.name.lexeme());
+
+  if (slot != -1) {
+    emit_u16(OpCode::GET_LOCAL, static_cast<uint16_t>(slot), line);
+  } else {
+    emit_u32(OpCode::GET_GLOBAL, name_constant(expr.name.lexeme()), line);
+  }
+}
+
+void Compiler::visitAssignExpr(Assign &expr) {
+  line = expr.name.line;
+  compile(expr.value);
+
+  int slot = resolve_local(expr.name.lexeme());
+
+  if (slot != -1) {
+    emit_u16(OpCode::SET_LOCAL, static_cast<uint16_t>(slot), expr.name.line);
+  } else {
+    emit_u32(OpCode::SET_GLOBAL, name_constant(expr.name.lexeme()),
+             expr.name.line);
+  }
+}
+
+void Compiler::visitLogicalExpr(Logical &expr) {
+  line = expr.op.line;
+  compile(expr.left);
+
+  if (expr.op.type == TokenType::OR) {
+    size_t else_jump = emit_jump(OpCode::JUMP_IF_FALSE);
+    size_t end_jump = emit_jump(OpCode::JUMP);
+
+    patch_jump(else_jump);
+    emit(OpCode::POP);
+    compile(expr.right);
+    patch_jump(end_jump);
+  } else {
+    size_t end_jump = emit_jump(OpCode::JUMP_IF_FALSE);
+
+    emit(OpCode::POP);
+    compile(expr.right);
+    patch_jump(end_jump);
+  }
+}
+
+void Compiler::visitExpressionStmt(Expression &stmt) {
+  compile(stmt.expr);
+  emit(OpCode::POP);
+}
+
+void Compiler::visitPrintStmt(Print &stmt) {
+  compile(stmt.expr);
+  emit(OpCode::PRINT);
+}
+
+void Compiler::visitVarStmt(Var &stmt) {
+  line = stmt.name.line;
+
+  if (stmt.initializer != nullptr) {
+    compile(stmt.initializer);
+  } else {
+    emit(OpCode::NIL);
+  }
+
+  if (scope_depth == 0) {
+    emit_u32(OpCode::DEFINE_GLOBAL, name_constant(stmt.name.lexeme()),
+             stmt.name.line);
+    return;
+  }
+
+  // Environment::define never overwrites an existing binding, so redeclaring
+  // a variable in the same block evaluates the initializer and drops it.
+  for (auto local = locals.rbegin();
+       local != locals.rend() && local->depth == scope_depth; local++) {
+    if (local->name == stmt.name.lexeme()) {
+      emit(OpCode::POP);
+      return;
+    }
+  }
+
+  if (locals.size() > UINT16_MAX) {
+    Vm::error(stmt.name, "Too many local variables.");
+    return;
+  }
+
+  locals.push_back(Local{stmt.name.lexeme(), scope_depth});
+}
+
+void Compiler::visitBlockStmt(Block &stmt) {
+  begin_scope();
+
+  for (shared_ptr<Stmt> statement : stmt.statements) {
+    compile(statement);
+  }
+
+  end_scope();
+}
+
+void Compiler::visitIfStmt(If &stmt) {
+  compile(stmt.condition);
+
+  size_t then_jump = emit_jump(OpCode::JUMP_IF_FALSE);
+  emit(OpCode::POP);
+  compile(stmt.then_branch);
+
+  size_t else_jump = emit_jump(OpCode::JUMP);
+  patch_jump(then_jump);
+  emit(OpCode::POP);
+
+  if (stmt.else_branch != nullptr) {
+    compile(stmt.else_branch);
+  }
+
+  patch_jump(else_jump);
+}
+
+void Compiler::visitWhileStmt(While &stmt) {
+  size_t loop_start = chunk.code.size();
+  compile(stmt.condition);
+
+  size_t exit_jump = emit_jump(OpCode::JUMP_IF_FALSE);
+  emit(OpCode::POP);
+  compile(stmt.body);
+  emit_loop(loop_start);
+
+  patch_jump(exit_jump);
+  emit(OpCode::POP);
+}
+
+void Compiler::emit(OpCode op) { emit(op, line); }
+
+void Compiler::emit(OpCode op, int line) { chunk.write(op, line); }
+
+void Compiler::emit_u16(OpCode op, uint16_t operand, int line) {
+  chunk.write(op, line);
+  chunk.write_u16(operand, line);
+}
+
+void Compiler::emit_u32(OpCode op, uint32_t operand, int line) {
+  chunk.write(op, line);
+  chunk.write_u32(operand, line);
+}
+
+size_t Compiler::emit_jump(OpCode op) {
+  emit_u32(op, 0, line);
+  return chunk.code.size() - 4;
+}
+
+void Compiler::patch_jump(size_t offset) {
+  uint32_t jump = static_cast<uint32_t>(chunk.code.size() - offset - 4);
+  chunk.patch_u32(offset, jump);
+}
+
+void Compiler::emit_loop(size_t loop_start) {
+  emit(OpCode::LOOP);
+  chunk.write_u32(static_cast<uint32_t>(chunk.code.size() + 4 - loop_start),
+                  line);
+}
+
+uint32_t Compiler::name_constant(string_view name) {
+  auto existing = names.find(name);
+
+  if (existing != names.end())
+    return existing->second;
+
+  uint32_t index = chunk.add_name(string(name));
+  names.insert(pair<string, uint32_t>(string(name), index));
+  return index;
+}
+
+int Compiler::resolve_local(string_view name) {
+  for (int i = static_cast<int>(locals.size()) - 1; i >= 0; i--) {
+    if (locals[i].name == name)
+      return i;
+  }
+
+  return -1;
+}
+
+void Compiler::begin_scope() { scope_depth++; }
+
+void Compiler::end_scope() {
+  scope_depth--;
+
+  while (!locals.empty() && locals.back().depth > scope_depth) {
+    emit(OpCode::POP);
+    locals.pop_back();
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "vm/chunk.h"
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include "vm/token.h"
+#include "vm/vm.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Lowers the statements produced by Parser::parse() into a Chunk for the
+// bytecode Machine. Block scoped variables live in stack slots resolved at
+// compile time, top level variables are looked up by name at runtime like the
+// Interpreter's global Environment.
+class Compiler final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  Chunk compile(vector<shared_ptr<Stmt>> statements);
+
+  void visitBinaryExpr(Binary &expr);
+  void visitGroupingExpr(Grouping &expr);
+  void visitLiteralExpr(Literal &expr);
+  void visitUnaryExpr(Unary &expr);
+  void visitVariableExpr(Variable &expr);
+  void visitAssignExpr(Assign &expr);
+  void visitLogicalExpr(Logical &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  struct Local {
+    string_view name;
+    int depth;
+  };
+
+  Chunk chunk;
+  vector<Local> locals;
+  map<string, uint32_t, less<>> names;
+  int scope_depth = 0;
+  // Statements carry no token, so instructions emitted for them inherit the
+  // line of the last token the compiler has seen.
+  int line = 0;
+
+  void compile(shared_ptr<Expr> expr);
+  void compile(shared_ptr<Stmt> stmt);
+  void emit(OpCode op);
+  void emit(OpCode op, int line);
+  void emit_u16(OpCode op, uint16_t operand, int line);
+  void emit_u32(OpCode op, uint32_t operand, int line);
+  size_t emit_jump(OpCode op);
+  void patch_jump(size_t offset);
+  void emit_loop(size_t loop_start);
+  uint32_t name_constant(string_view name);
+  int resolve_local(string_view name);
+  void begin_scope();
+  void end_scope();
+};
+
+#endif
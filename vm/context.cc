@@ -0,0 +1,186 @@
+#include "vm/context.h"
+#include "literals/heap.h"
+#include "literals/string.h"
+#include "vm/optimizer.h"
+#include "vm/parser.h"
+#include "vm/resolver.h"
+#include "vm/scanner.h"
+#include <unordered_map>
+
+atomic<uint64_t> Program::programs(0);
+
+namespace {
+
+// Replaces the string Literals of a tree, whose values belong to the
+// compiling thread's Heap and StringTable, by Literals of copies the Program
+// owns.
+class LiteralOwner final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  explicit LiteralOwner(vector<unique_ptr<String>> &literals)
+      : literals(literals) {}
+
+  void own(shared_ptr<Expr> &expr) {
+    if (expr == nullptr) {
+      return;
+    }
+
+    expr->accept(this);
+
+    if (replacement != nullptr) {
+      expr = move(replacement);
+    }
+  }
+
+  void own(const shared_ptr<Stmt> &stmt) {
+    if (stmt != nullptr) {
+      stmt->accept(this);
+    }
+  }
+
+  void visitBinaryExpr(Binary &expr) {
+    own(expr.left);
+    own(expr.right);
+  }
+
+  void visitGroupingExpr(Grouping &expr) { own(expr.expression); }
+
+  void visitLiteralExpr(Literal &expr) {
+    if (!expr.value.is_string()) {
+      return;
+    }
+
+    // Literals are interned, so equal texts share one String and one copy.
+    String *&copy = copies[expr.value.as_string()];
+
+    if (copy == nullptr) {
+      literals.push_back(String::literal(expr.value.as_string()->view()));
+      copy = literals.back().get();
+    }
+
+    replacement = make_shared<Literal>(Value(copy));
+  }
+
+  void visitUnaryExpr(Unary &expr) { own(expr.right); }
+  void visitVariableExpr(Variable &expr) {}
+  void visitAssignExpr(Assign &expr) { own(expr.value); }
+
+  void visitLogicalExpr(Logical &expr) {
+    own(expr.left);
+    own(expr.right);
+  }
+
+  void visitExpressionStmt(Expression &stmt) { own(stmt.expr); }
+  void visitPrintStmt(Print &stmt) { own(stmt.expr); }
+  void visitVarStmt(Var &stmt) { own(stmt.initializer); }
+
+  void visitBlockStmt(Block &stmt) {
+    for (const shared_ptr<Stmt> &statement : stmt.statements) {
+      own(statement);
+    }
+  }
+
+  void visitIfStmt(If &stmt) {
+    own(stmt.condition);
+    own(stmt.then_branch);
+    own(stmt.else_branch);
+  }
+
+  void visitWhileStmt(While &stmt) {
+    own(stmt.condition);
+    own(stmt.body);
+  }
+
+private:
+  vector<unique_ptr<String>> &literals;
+  unordered_map<const String *, String *> copies;
+  // Set by visitLiteralExpr for own to put in place of the visited node.
+  shared_ptr<Expr> replacement;
+};
+
+} // namespace
+
+Context::Context(int optimization)
+    : optimization(optimization), session(output, output) {
+  Heap::instance().add_roots(&strings);
+}
+
+Context::~Context() { Heap::instance().remove_roots(&strings); }
+
+unique_ptr<Program> Context::compile(string source) {
+  unique_ptr<Program> program(new Program());
+  program->source = make_unique<Source>(move(source));
+
+  Session::Scope scope(session);
+  session.errors = &program->syntax_errors;
+
+  Scanner scanner = Scanner(program->source->view());
+  vector<Token> tokens = scanner.scan_tokens();
+  Parser parser = Parser(move(tokens), scanner.literals());
+  vector<shared_ptr<Stmt>> statements = parser.parse();
+
+  if (program->ok()) {
+    program->statements = Optimizer(optimization).optimize(statements);
+    Resolver(&program->globals).resolve(program->statements);
+    LiteralOwner owner(program->literals);
+
+    for (const shared_ptr<Stmt> &statement : program->statements) {
+      owner.own(statement);
+    }
+  }
+
+  session.errors = nullptr;
+  return program;
+}
+
+Evaluation Context::evaluate(const Program &program,
+                             const vector<pair<string, Value>> &globals) {
+  Evaluation evaluation;
+
+  if (!program.ok()) {
+    evaluation.errors = program.errors();
+    return evaluation;
+  }
+
+  Environment &environment = interpreter.global_environment();
+
+  if (layout == program.id) {
+    environment.clear();
+  } else {
+    environment = program.globals;
+    layout = program.id;
+  }
+
+  for (const auto &[name, value] : globals) {
+    environment.define(environment.slot(name), value);
+  }
+
+  strings.clear();
+  output.str("");
+
+  {
+    Session::Scope scope(session);
+    session.errors = &evaluation.errors;
+    evaluation.value = interpreter.evaluate_program(program.statements);
+    session.errors = nullptr;
+  }
+
+  evaluation.output = output.str();
+  return evaluation;
+}
+
+Value Context::make_string(string_view text) {
+  strings.push_back(Value(new String(string(text))));
+  return strings.back();
+}
+
+Value Context::global(const string &name) const {
+  const Environment &environment = interpreter.global_environment();
+  auto slot = environment.names().find(name);
+
+  if (slot == environment.names().end() ||
+      environment.get(slot->second) == nullptr) {
+    return Value();
+  }
+
+  return *environment.get(slot->second);
+}
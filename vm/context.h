@@ -0,0 +1,110 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "literals/string.h"
+#include "literals/value.h"
+#include "vm/environment.h"
+#include "vm/interpreter.h"
+#include "vm/session.h"
+#include "vm/source.h"
+#include "vm/stmt.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A script compiled by Context::compile: scanned, parsed, optimized and
+// resolved once, then evaluated any number of times.
+//
+// A program is immutable once compiled, so any number of Contexts, on any
+// threads, may evaluate it at the same time, including after the thread that
+// compiled it has exited. It carries its own layout of global slots, which
+// each Context adopts, and owns its string literals, which no Heap collects.
+class Program final {
+public:
+  bool ok() const { return syntax_errors.empty(); }
+  // A program with syntax errors cannot be evaluated.
+  const vector<ScriptError> &errors() const { return syntax_errors; }
+
+private:
+  friend class Context;
+
+  Program() : id(++programs) {}
+
+  static atomic<uint64_t> programs;
+
+  // Tells Contexts whether they already have this program's layout.
+  const uint64_t id;
+  // Tokens point into it.
+  unique_ptr<Source> source;
+  vector<shared_ptr<Stmt>> statements;
+  // Every global the program names, with its slot and no value.
+  Environment globals;
+  // The strings its Literals hold, one per distinct text.
+  vector<unique_ptr<String>> literals;
+  vector<ScriptError> syntax_errors;
+};
+
+// What one Context::evaluate produced.
+struct Evaluation {
+  bool ok() const { return errors.empty(); }
+
+  // The value of the program's last statement when it is an expression
+  // statement, or nil. A string stays valid until the next evaluate on the
+  // same Context.
+  Value value;
+  // Everything the program printed.
+  string output;
+  // The syntax errors of the program, or the runtime error that stopped it.
+  vector<ScriptError> errors;
+};
+
+// The interpreter as a library, for embedding. Where Vm::execute prints, a
+// Context returns: output, errors and the result of every evaluation come
+// back in an Evaluation, and nothing is written to cout or left in the
+// standard Session.
+//
+// A script meant to run per request is compiled once, and each evaluate then
+// only clears the globals, defines the ones it is given and runs the tree
+// engine over the compiled program. The globals a program leaves behind can
+// be read back with global until the next evaluate.
+//
+// A Context and its values belong to the thread that created it, whose Heap
+// holds them. Threads each need a Context of their own, but may share
+// programs.
+class Context final {
+public:
+  explicit Context(int optimization = 1);
+  ~Context();
+  Context(const Context &) = delete;
+  Context &operator=(const Context &) = delete;
+
+  unique_ptr<Program> compile(string source);
+  // Runs program from fresh globals, with the given ones defined first.
+  Evaluation evaluate(const Program &program,
+                      const vector<pair<string, Value>> &globals = {});
+
+  // A string to bind to a global in the next evaluate, kept alive until
+  // then.
+  Value make_string(string_view text);
+  // A global as the last evaluate left it, or nil if it is not defined.
+  Value global(const string &name) const;
+
+private:
+  int optimization;
+  // The id of the program whose layout the globals have, or 0.
+  uint64_t layout = 0;
+  ostringstream output;
+  Session session;
+  EvaluatingInterpreter interpreter;
+  // Made by make_string and not bound yet.
+  vector<Value> strings;
+};
+
+#endif
@@ -1,29 +1,55 @@
 #include "vm/environment.h"
+#include <algorithm>
 
-void Environment::define(string name, shared_ptr<Object> value) {
-  values.insert(pair<string, shared_ptr<Object>>(name, value));
+int Environment::slot(const string &name) {
+  auto existing = slots.find(name);
+
+  if (existing != slots.end()) {
+    return existing->second;
+  }
+
+  int slot = static_cast<int>(values.size());
+  slots.insert(pair<string, int>(name, slot));
+  values.push_back(Value());
+  defined.push_back(false);
+  return slot;
 }
 
-shared_ptr<Object> Environment::get(Token name) {
-  try {
-    return values.at(name.lexeme);
-  } catch (const std::exception &e) {
-    if (enclosing != nullptr) {
-      return enclosing->get(name);
-    }
+void Environment::define(int slot, Value value) {
+  // Redefining a variable keeps its first value.
+  if (defined[slot]) {
+    return;
+  }
+
+  values[slot] = value;
+  defined[slot] = true;
+}
 
-    throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
+const Value *Environment::get(int slot) const {
+  if (!defined[slot]) {
+    return nullptr;
   }
+
+  return &values[slot];
+}
+
+void Environment::clear() {
+  fill(values.begin(), values.end(), Value());
+  fill(defined.begin(), defined.end(), false);
 }
 
-void Environment::assign(Token name, shared_ptr<Object> value) {
-  try {
-    values.at(name.lexeme) = value;
-  } catch (const std::exception &e) {
-    if (enclosing != nullptr) {
-      enclosing->assign(name, value);
-    } else {
-      throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
-    }
+bool Environment::assign(int slot, Value value) {
+  if (!defined[slot]) {
+    return false;
   }
+
+  values[slot] = value;
+  return true;
+}
+
+size_t Environment::bytes() const {
+  // Each name is a hash node holding the string and its slot.
+  size_t node = sizeof(pair<const string, int>) + 2 * sizeof(void *);
+  return slots.bucket_count() * sizeof(void *) + slots.size() * node +
+         values.capacity() * sizeof(Value) + defined.capacity() / 8;
 }
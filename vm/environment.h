@@ -1,26 +1,41 @@
 #ifndef ENVIRONMENT_H
 #define ENVIRONMENT_H
 
-#include "literals/object.h"
-#include "vm/errors.h"
-#include "vm/token.h"
-#include <map>
+#include "literals/value.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
+// Top level variables. Every name is interned into a dense slot the first time
+// it is seen. The Resolver lays out the slots of every global a program names
+// in the Environment it is given and writes them into the AST, so accesses are
+// a single indexed load; the Interpreter only looks a name up when a tree was
+// resolved without one. A slot exists before its variable is defined, so
+// definedness is tracked separately and lookups of undefined variables fail
+// by returning nullptr / false for the caller to report.
 class Environment final {
 public:
-  Environment() { this->enclosing = nullptr; }
-  Environment(shared_ptr<Environment> enclosing) : enclosing(enclosing) {}
-
-  void define(string name, shared_ptr<Object> value);
-  void assign(Token name, shared_ptr<Object> value);
-  shared_ptr<Object> get(Token name);
-
-  shared_ptr<Environment> enclosing;
+  int slot(const string &name);
+  void define(int slot, Value value);
+  bool assign(int slot, Value value);
+  const Value *get(int slot) const;
+  // Undefines every variable but keeps the slots, which resolved programs
+  // refer to.
+  void clear();
+  // Every name with a slot, defined or not, for Snapshot.
+  const unordered_map<string, int> &names() const { return slots; }
+  // Approximate bytes held, for --heap-stats.
+  size_t bytes() const;
+  size_t size() const { return values.size(); }
+  // For the Heap, which treats every stored value as a root.
+  const vector<Value> *roots() const { return &values; }
 
 private:
-  map<string, shared_ptr<Object>> values;
+  unordered_map<string, int> slots;
+  vector<Value> values;
+  vector<bool> defined;
 };
 
 #endif
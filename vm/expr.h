@@ -1,9 +1,11 @@
 #ifndef EXPRESSIONS_H
 #define EXPRESSIONS_H
 
-#include "literals/object.h"
 #include "literals/string.h"
+#include "literals/value.h"
 #include "vm/token.h"
+#include <atomic>
+#include <memory>
 
 class Binary;
 class Grouping;
@@ -17,48 +19,81 @@ using namespace std;
 
 template <class T> class Visitor {
 public:
-  virtual T visitBinaryExpr(Binary expr) = 0;
-  virtual T visitGroupingExpr(Grouping expr) = 0;
-  virtual T visitLiteralExpr(Literal expr) = 0;
-  virtual T visitUnaryExpr(Unary expr) = 0;
-  virtual T visitVariableExpr(Variable expr) = 0;
-  virtual T visitAssignExpr(Assign expr) = 0;
-  virtual T visitLogicalExpr(Logical expr) = 0;
+  virtual T visitBinaryExpr(Binary &expr) = 0;
+  virtual T visitGroupingExpr(Grouping &expr) = 0;
+  virtual T visitLiteralExpr(Literal &expr) = 0;
+  virtual T visitUnaryExpr(Unary &expr) = 0;
+  virtual T visitVariableExpr(Variable &expr) = 0;
+  virtual T visitAssignExpr(Assign &expr) = 0;
+  virtual T visitLogicalExpr(Logical &expr) = 0;
 };
 
 class Expr {
 public:
   virtual String accept(Visitor<String> *visitor) = 0;
-  virtual shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) = 0;
+  virtual Value accept(Visitor<Value> *visitor) = 0;
+  virtual void accept(Visitor<void> *visitor) = 0;
+};
+
+// What the Interpreter specialized a Binary or Unary site to, from the operand
+// types it saw the first time the site ran. Sites that saw anything else, or
+// whose guard failed later on, are GENERIC for good.
+//
+// This is the only part of an expression written while it runs. It is a
+// hint, since every specialized path checks its operand types anyway, so
+// Interpreters running the same tree on several threads share it through
+// relaxed atomic loads and stores, which are plain moves on x86-64.
+enum class Specialization : uint8_t {
+  UNSEEN,
+  GENERIC,
+  NUMBER_ADD,
+  NUMBER_SUBTRACT,
+  NUMBER_MULTIPLY,
+  NUMBER_DIVIDE,
+  NUMBER_GREATER,
+  NUMBER_GREATER_EQUAL,
+  NUMBER_LESS,
+  NUMBER_LESS_EQUAL,
+  NUMBER_NEGATE,
+  STRING_CONCAT,
 };
 
 class Binary final : public Expr {
 public:
   Binary(shared_ptr<Expr> left, Token op, shared_ptr<Expr> right)
-      : left(left), op(op), right(right) {}
+      : left(move(left)), op(op), right(move(right)) {}
 
   String accept(Visitor<String> *visitor) {
     return visitor->visitBinaryExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitBinaryExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitBinaryExpr(*this);
   }
 
   shared_ptr<Expr> left;
   const Token op;
   shared_ptr<Expr> right;
+  atomic<Specialization> specialization{Specialization::UNSEEN};
 };
 
 class Grouping final : public Expr {
 public:
-  Grouping(shared_ptr<Expr> expression) : expression(expression) {}
+  Grouping(shared_ptr<Expr> expression) : expression(move(expression)) {}
 
   String accept(Visitor<String> *visitor) {
     return visitor->visitGroupingExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitGroupingExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitGroupingExpr(*this);
   }
 
@@ -67,33 +102,42 @@ public:
 
 class Literal final : public Expr {
 public:
-  Literal(shared_ptr<Object> value) : value(value) {}
+  Literal(Value value) : value(value) {}
 
   String accept(Visitor<String> *visitor) {
     return visitor->visitLiteralExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitLiteralExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitLiteralExpr(*this);
   }
 
-  const shared_ptr<Object> value;
+  const Value value;
 };
 
 class Unary final : public Expr {
 public:
-  Unary(Token op, shared_ptr<Expr> right) : op(op), right(right) {}
+  Unary(Token op, shared_ptr<Expr> right) : op(op), right(move(right)) {}
 
   String accept(Visitor<String> *visitor) {
     return visitor->visitUnaryExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitUnaryExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitUnaryExpr(*this);
   }
 
   Token op;
   shared_ptr<Expr> right;
+  atomic<Specialization> specialization{Specialization::UNSEEN};
 };
 
 class Variable final : public Expr {
@@ -104,39 +148,63 @@ public:
     return visitor->visitVariableExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitVariableExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitVariableExpr(*this);
   }
 
   Token name;
+  // Filled in by the Resolver. A depth of -1 means the variable is global,
+  // in which case global is its Environment slot if the Resolver was given
+  // the environment, and -1 otherwise.
+  int depth = -1;
+  int slot = -1;
+  int global = -1;
 };
 
 class Assign final : public Expr {
 public:
-  Assign(Token name, shared_ptr<Expr> value) : name(name), value(value) {}
+  Assign(Token name, shared_ptr<Expr> value) : name(name), value(move(value)) {}
 
   String accept(Visitor<String> *visitor) {
     return visitor->visitAssignExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitAssignExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitAssignExpr(*this);
   }
 
   Token name;
   shared_ptr<Expr> value;
+  // Filled in by the Resolver. A depth of -1 means the variable is global,
+  // in which case global is its Environment slot if the Resolver was given
+  // the environment, and -1 otherwise.
+  int depth = -1;
+  int slot = -1;
+  int global = -1;
 };
 
 class Logical final : public Expr {
 public:
   Logical(shared_ptr<Expr> left, Token op, shared_ptr<Expr> right)
-      : left(left), op(op), right(right) {}
+      : left(move(left)), op(op), right(move(right)) {}
 
   String accept(Visitor<String> *visitor) {
     return visitor->visitLogicalExpr(*this);
   }
 
-  shared_ptr<Object> accept(Visitor<shared_ptr<Object>> *visitor) {
+  Value accept(Visitor<Value> *visitor) {
+    return visitor->visitLogicalExpr(*this);
+  }
+
+  void accept(Visitor<void> *visitor) {
     return visitor->visitLogicalExpr(*this);
   }
 
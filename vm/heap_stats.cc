@@ -0,0 +1,223 @@
+#include "vm/heap_stats.h"
+#include "literals/heap.h"
+#include "vm/stats.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sys/resource.h>
+
+bool HeapStats::enabled = false;
+double HeapStats::interval_ms = 0;
+
+uint32_t HeapStats::current = 0;
+HeapStats::Account HeapStats::accounts[4];
+vector<HeapStats::Site> HeapStats::sites;
+double HeapStats::started_ms = 0;
+double HeapStats::next_ms = 0;
+
+static const char *const CATEGORY_NAMES[] = {"tokens", "ast", "environment",
+                                             "objects"};
+
+// What make_shared allocates besides the object: the reference counts.
+static constexpr size_t CONTROL_BLOCK = 2 * sizeof(long);
+
+// Sums the sizes of the nodes of a tree.
+class NodeSizer final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  size_t bytes = 0;
+  size_t nodes = 0;
+
+  template <typename T> void add(T &node) {
+    bytes += sizeof(T) + CONTROL_BLOCK;
+    nodes++;
+  }
+
+  void size(const shared_ptr<Stmt> &stmt) {
+    if (stmt != nullptr) {
+      stmt->accept(this);
+    }
+  }
+
+  void size(const shared_ptr<Expr> &expr) {
+    if (expr != nullptr) {
+      expr->accept(this);
+    }
+  }
+
+  void visitBinaryExpr(Binary &expr) {
+    add(expr);
+    size(expr.left);
+    size(expr.right);
+  }
+
+  void visitGroupingExpr(Grouping &expr) {
+    add(expr);
+    size(expr.expression);
+  }
+
+  void visitLiteralExpr(Literal &expr) { add(expr); }
+
+  void visitUnaryExpr(Unary &expr) {
+    add(expr);
+    size(expr.right);
+  }
+
+  void visitVariableExpr(Variable &expr) { add(expr); }
+
+  void visitAssignExpr(Assign &expr) {
+    add(expr);
+    size(expr.value);
+  }
+
+  void visitLogicalExpr(Logical &expr) {
+    add(expr);
+    size(expr.left);
+    size(expr.right);
+  }
+
+  void visitExpressionStmt(Expression &stmt) {
+    add(stmt);
+    size(stmt.expr);
+  }
+
+  void visitPrintStmt(Print &stmt) {
+    add(stmt);
+    size(stmt.expr);
+  }
+
+  void visitVarStmt(Var &stmt) {
+    add(stmt);
+    size(stmt.initializer);
+  }
+
+  void visitBlockStmt(Block &stmt) {
+    add(stmt);
+    bytes += stmt.statements.capacity() * sizeof(shared_ptr<Stmt>);
+
+    for (const shared_ptr<Stmt> &statement : stmt.statements) {
+      size(statement);
+    }
+  }
+
+  void visitIfStmt(If &stmt) {
+    add(stmt);
+    size(stmt.condition);
+    size(stmt.then_branch);
+    size(stmt.else_branch);
+  }
+
+  void visitWhileStmt(While &stmt) {
+    add(stmt);
+    size(stmt.condition);
+    size(stmt.body);
+  }
+};
+
+void HeapStats::install() {
+  Heap::instance().on_track = track;
+  started_ms = Stats::now_ms();
+  next_ms = started_ms + interval_ms;
+}
+
+void HeapStats::allocate(Category category, size_t bytes, size_t count) {
+  Account &account = accounts[static_cast<size_t>(category)];
+  account.allocations += count;
+  account.live += bytes;
+  account.peak = max(account.peak, account.live);
+}
+
+void HeapStats::release(Category category, size_t bytes) {
+  Account &account = accounts[static_cast<size_t>(category)];
+  account.live -= min(account.live, bytes);
+}
+
+void HeapStats::measure(Category category, size_t bytes, size_t count) {
+  Account &account = accounts[static_cast<size_t>(category)];
+  account.allocations = max(account.allocations, count);
+  account.live = bytes;
+  account.peak = max(account.peak, account.live);
+}
+
+size_t HeapStats::ast_bytes(const vector<shared_ptr<Stmt>> &statements,
+                            size_t &nodes) {
+  NodeSizer sizer;
+
+  for (const shared_ptr<Stmt> &statement : statements) {
+    sizer.size(statement);
+  }
+
+  nodes = sizer.nodes;
+  return sizer.bytes + statements.capacity() * sizeof(shared_ptr<Stmt>);
+}
+
+void HeapStats::track(size_t bytes) {
+  if (current >= sites.size()) {
+    sites.resize(current + 1);
+  }
+
+  sites[current].objects++;
+  sites[current].bytes += bytes;
+}
+
+void HeapStats::poll() {
+  if (interval_ms <= 0) {
+    return;
+  }
+
+  double now = Stats::now_ms();
+
+  if (now >= next_ms) {
+    long elapsed = static_cast<long>(now - started_ms);
+    report(cerr, "snapshot at " + to_string(elapsed) + " ms");
+    next_ms = now + interval_ms;
+  }
+}
+
+void HeapStats::report(ostream &out, const string &when) {
+  const Heap &heap = Heap::instance();
+  Account &objects = accounts[static_cast<size_t>(Category::OBJECTS)];
+  objects.allocations = heap.objects_allocated();
+  objects.live = heap.live_bytes();
+  objects.peak = heap.peak_live_bytes();
+
+  rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+
+  // ru_maxrss is in kilobytes on Linux.
+  out << "[heap] " << when << ": peak RSS " << usage.ru_maxrss << " KB"
+      << endl;
+  out << "[heap]   category     allocations    live bytes    peak bytes"
+      << endl;
+
+  for (size_t i = 0; i < 4; i++) {
+    out << "[heap]   " << left << setw(11) << CATEGORY_NAMES[i] << right
+        << setw(13) << accounts[i].allocations << setw(14) << accounts[i].live
+        << setw(14) << accounts[i].peak << endl;
+  }
+
+  vector<uint32_t> lines;
+
+  for (uint32_t line = 0; line < sites.size(); line++) {
+    if (sites[line].objects > 0) {
+      lines.push_back(line);
+    }
+  }
+
+  sort(lines.begin(), lines.end(), [](uint32_t a, uint32_t b) {
+    return sites[a].bytes != sites[b].bytes ? sites[a].bytes > sites[b].bytes
+                                            : a < b;
+  });
+
+  if (!lines.empty()) {
+    out << "[heap] top allocating lines:" << endl;
+  }
+
+  for (size_t i = 0; i < lines.size() && i < 10; i++) {
+    const Site &site = sites[lines[i]];
+    out << "[heap]   "
+        << (lines[i] == 0 ? string("outside statements")
+                          : "line " + to_string(lines[i]))
+        << ": " << site.objects << " objects, " << site.bytes << " bytes"
+        << endl;
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+// Memory accounting behind --heap-stats.
+//
+// Tracks allocations and live bytes per category: the token array, the AST,
+// the global Environment and the interpreter's local frames, and runtime
+// objects on the Heap. Numbers, booleans and nil are unboxed Values and never
+// allocate. Runtime allocations are also charged to the line of the statement
+// executing when they happen, which the HeapAccountingInterpreter keeps up to
+// date; with the other engines they all go to line 0, as does everything
+// allocated while scanning and parsing.
+//
+// The report goes to stderr at exit and, with --heap-stats=ms, every ms
+// milliseconds while the tree engine runs.
+class HeapStats final {
+public:
+  enum class Category : uint8_t { TOKENS, AST, ENVIRONMENT, OBJECTS };
+
+  static bool enabled;
+  // Milliseconds between snapshots, 0 for none.
+  static double interval_ms;
+
+  // Sets the statement line runtime allocations are charged to while it
+  // runs.
+  class Line final {
+  public:
+    explicit Line(uint32_t line) : previous(current) { current = line; }
+    ~Line() { current = previous; }
+
+  private:
+    uint32_t previous;
+  };
+
+  static void install();
+  static void allocate(Category category, size_t bytes, size_t count = 1);
+  static void release(Category category, size_t bytes);
+  // For categories measured rather than tracked: sets the live bytes. The
+  // allocation count reported is the largest count measured.
+  static void measure(Category category, size_t bytes, size_t count);
+  // Approximate bytes held by an AST, nodes and child vectors included.
+  static size_t ast_bytes(const vector<shared_ptr<Stmt>> &statements,
+                          size_t &nodes);
+  // Prints a snapshot if one is due.
+  static void poll();
+  static void report(ostream &out, const string &when);
+
+private:
+  struct Account {
+    size_t allocations = 0;
+    size_t live = 0;
+    size_t peak = 0;
+  };
+
+  // Runtime objects allocated on a line, and their bytes.
+  struct Site {
+    size_t objects = 0;
+    size_t bytes = 0;
+  };
+
+  static uint32_t current;
+  static Account accounts[4];
+  static vector<Site> sites;
+  static double started_ms;
+  static double next_ms;
+
+  static void track(size_t bytes);
+};
+
+#endif
@@ -1,202 +1,343 @@
 #include "vm/interpreter.h"
 
-shared_ptr<Object> Interpreter::visitLiteralExpr(Literal expr) {
-  return expr.value;
+thread_local FeedbackStats Interpreter::feedback;
+
+void FeedbackStats::report(ostream &out) const {
+  out << "[feedback] sites specialized: " << specialized
+      << ", deoptimized: " << deoptimized << endl;
+}
+
+Interpreter::Interpreter() {
+  Heap::instance().add_roots(globals.roots());
+  Heap::instance().add_roots(&locals);
+}
+
+Interpreter::~Interpreter() {
+  Heap::instance().remove_roots(globals.roots());
+  Heap::instance().remove_roots(&locals);
 }
 
-shared_ptr<Object> Interpreter::visitGroupingExpr(Grouping expr) {
+void Interpreter::measure_environment() const {
+  HeapStats::measure(HeapStats::Category::ENVIRONMENT,
+                     globals.bytes() + locals.capacity() * sizeof(Value) +
+                         frames.capacity() * sizeof(size_t),
+                     globals.size() + locals.size());
+}
+
+Value Interpreter::visitLiteralExpr(Literal &expr) { return expr.value; }
+
+Value Interpreter::visitGroupingExpr(Grouping &expr) {
   return evaluate(expr.expression);
 }
 
-shared_ptr<Object> Interpreter::evaluate(shared_ptr<Expr> expr) {
+Value Interpreter::evaluate(const shared_ptr<Expr> &expr) {
   return expr->accept(this);
 }
 
-shared_ptr<Object> Interpreter::visitUnaryExpr(Unary expr) {
-  shared_ptr<Object> right = evaluate(expr.right);
-  shared_ptr<Number> number;
+Value Interpreter::visitUnaryExpr(Unary &expr) {
+  Value right = evaluate(expr.right);
 
   switch (expr.op.type) {
   case TokenType::BANG:
-    return make_shared<Boolean>(!is_truthy(right));
-  case TokenType::MINUS:
+    return Value(!is_truthy(right));
+  case TokenType::MINUS: {
+    Specialization seen = expr.specialization.load(memory_order_relaxed);
+
+    if (seen == Specialization::NUMBER_NEGATE) {
+      if (right.is_number()) {
+        return Value(-right.as_number());
+      }
+
+      expr.specialization.store(Specialization::GENERIC, memory_order_relaxed);
+      feedback.deoptimized++;
+    } else if (seen == Specialization::UNSEEN) {
+      expr.specialization.store(right.is_number()
+                                    ? Specialization::NUMBER_NEGATE
+                                    : Specialization::GENERIC,
+                                memory_order_relaxed);
+      feedback.specialized += right.is_number();
+    }
+
     check_number_operand(expr.op, right);
-    number = dynamic_pointer_cast<Number>(right);
-    number->value = -number->value;
-    return number;
+    return Value(-right.as_number());
+  }
   default:
-    return nullptr;
+    return Value();
   }
 }
 
-bool Interpreter::is_truthy(shared_ptr<Object> obj) {
-  if (obj == nullptr) {
-    return false;
+bool Interpreter::is_truthy(const Value &value) { return value.is_truthy(); }
+
+// A site is specialized to the operation and operand types it sees the first
+// time it runs, after which it only checks that the types still match. When
+// they do not, the site goes back to the generic code below for good.
+Value Interpreter::visitBinaryExpr(Binary &expr) {
+  Value left = evaluate(expr.left);
+  Value right = evaluate(expr.right);
+  bool numbers = left.is_number() && right.is_number();
+
+  switch (expr.specialization.load(memory_order_relaxed)) {
+  case Specialization::NUMBER_ADD:
+    if (numbers)
+      return Value(left.as_number() + right.as_number());
+    break;
+  case Specialization::NUMBER_SUBTRACT:
+    if (numbers)
+      return Value(left.as_number() - right.as_number());
+    break;
+  case Specialization::NUMBER_MULTIPLY:
+    if (numbers)
+      return Value(left.as_number() * right.as_number());
+    break;
+  case Specialization::NUMBER_DIVIDE:
+    if (numbers)
+      return Value(left.as_number() / right.as_number());
+    break;
+  case Specialization::NUMBER_GREATER:
+    if (numbers)
+      return Value(left.as_number() > right.as_number());
+    break;
+  case Specialization::NUMBER_GREATER_EQUAL:
+    if (numbers)
+      return Value(left.as_number() >= right.as_number());
+    break;
+  case Specialization::NUMBER_LESS:
+    if (numbers)
+      return Value(left.as_number() < right.as_number());
+    break;
+  case Specialization::NUMBER_LESS_EQUAL:
+    if (numbers)
+      return Value(left.as_number() <= right.as_number());
+    break;
+  case Specialization::STRING_CONCAT:
+    if (left.is_string() && right.is_string())
+      return Value(String::concat(*left.as_string(), *right.as_string()));
+    break;
+  case Specialization::UNSEEN: {
+    Specialization seen = specialize(expr.op.type, left, right);
+    expr.specialization.store(seen, memory_order_relaxed);
+    feedback.specialized += seen != Specialization::GENERIC;
+    return generic_binary(expr, left, right);
   }
-
-  if (typeid(*obj) == typeid(Boolean)) {
-    return dynamic_pointer_cast<Boolean>(obj)->value;
+  default:
+    return generic_binary(expr, left, right);
   }
 
-  return true;
+  expr.specialization.store(Specialization::GENERIC, memory_order_relaxed);
+  feedback.deoptimized++;
+  return generic_binary(expr, left, right);
 }
 
-shared_ptr<Object> Interpreter::visitBinaryExpr(Binary expr) {
-  shared_ptr<Object> left = evaluate(expr.left);
-  shared_ptr<Object> right = evaluate(expr.right);
+Specialization Interpreter::specialize(TokenType op, const Value &left,
+                                       const Value &right) {
+  if (op == TokenType::PLUS && left.is_string() && right.is_string()) {
+    return Specialization::STRING_CONCAT;
+  }
+
+  if (!left.is_number() || !right.is_number()) {
+    return Specialization::GENERIC;
+  }
 
+  switch (op) {
+  case TokenType::PLUS:
+    return Specialization::NUMBER_ADD;
+  case TokenType::MINUS:
+    return Specialization::NUMBER_SUBTRACT;
+  case TokenType::STAR:
+    return Specialization::NUMBER_MULTIPLY;
+  case TokenType::SLASH:
+    return Specialization::NUMBER_DIVIDE;
+  case TokenType::GREATER:
+    return Specialization::NUMBER_GREATER;
+  case TokenType::GREATER_EQUAL:
+    return Specialization::NUMBER_GREATER_EQUAL;
+  case TokenType::LESS:
+    return Specialization::NUMBER_LESS;
+  case TokenType::LESS_EQUAL:
+    return Specialization::NUMBER_LESS_EQUAL;
+  default:
+    return Specialization::GENERIC;
+  }
+}
+
+Value Interpreter::generic_binary(const Binary &expr, const Value &left,
+                                  const Value &right) {
   switch (expr.op.type) {
   case TokenType::MINUS:
     check_number_operands(expr.op, left, right);
-    return make_shared<Number>(dynamic_pointer_cast<Number>(left)->value -
-                               dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() - right.as_number());
   case TokenType::SLASH:
     check_number_operands(expr.op, left, right);
-    return make_shared<Number>(dynamic_pointer_cast<Number>(left)->value /
-                               dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() / right.as_number());
   case TokenType::STAR:
     check_number_operands(expr.op, left, right);
-    return make_shared<Number>(dynamic_pointer_cast<Number>(left)->value *
-                               dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() * right.as_number());
   case TokenType::PLUS:
-    if (typeid(*left) == typeid(Number) && typeid(*right) == typeid(Number)) {
-      return make_shared<Number>(dynamic_pointer_cast<Number>(left)->value +
-                                 dynamic_pointer_cast<Number>(right)->value);
+    if (left.is_number() && right.is_number()) {
+      return Value(left.as_number() + right.as_number());
     }
 
-    if (typeid(*left) == typeid(String) && typeid(*right) == typeid(String)) {
-      return make_shared<String>(dynamic_pointer_cast<String>(left)->value +
-                                 dynamic_pointer_cast<String>(right)->value);
+    if (left.is_string() && right.is_string()) {
+      return Value(String::concat(*left.as_string(), *right.as_string()));
     }
 
     throw RuntimeError(expr.op, "Operands must be two numbers or two strings.");
   case TokenType::GREATER:
     check_number_operands(expr.op, left, right);
-    return make_shared<Boolean>(dynamic_pointer_cast<Number>(left)->value >
-                                dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() > right.as_number());
   case TokenType::GREATER_EQUAL:
     check_number_operands(expr.op, left, right);
-    return make_shared<Boolean>(dynamic_pointer_cast<Number>(left)->value >=
-                                dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() >= right.as_number());
   case TokenType::LESS:
     check_number_operands(expr.op, left, right);
-    return make_shared<Boolean>(dynamic_pointer_cast<Number>(left)->value <
-                                dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() < right.as_number());
   case TokenType::LESS_EQUAL:
     check_number_operands(expr.op, left, right);
-    return make_shared<Boolean>(dynamic_pointer_cast<Number>(left)->value <=
-                                dynamic_pointer_cast<Number>(right)->value);
+    return Value(left.as_number() <= right.as_number());
   case TokenType::BANG_EQUAL:
-    return make_shared<Boolean>(!is_equal(left, right));
+    return Value(!is_equal(left, right));
   case TokenType::EQUAL_EQUAL:
-    return make_shared<Boolean>(is_equal(left, right));
+    return Value(is_equal(left, right));
   default:
-    return nullptr;
+    return Value();
   }
 }
 
-bool Interpreter::is_equal(shared_ptr<Object> a, shared_ptr<Object> b) {
-  if (a == nullptr && b == nullptr) {
-    return true;
-  }
-
-  if (a == nullptr) {
-    return false;
-  }
-
-  return a == b;
-}
+bool Interpreter::is_equal(const Value &a, const Value &b) { return a == b; }
 
-void Interpreter::check_number_operand(Token op, shared_ptr<Object> operand) {
-  if (typeid(*operand) == typeid(Number)) {
+void Interpreter::check_number_operand(Token op, const Value &operand) {
+  if (operand.is_number()) {
     return;
   }
 
   throw RuntimeError(op, "Operand must be a number.");
 }
 
-void Interpreter::check_number_operands(Token op, shared_ptr<Object> left,
-                                        shared_ptr<Object> right) {
+void Interpreter::check_number_operands(Token op, const Value &left,
+                                        const Value &right) {
 
-  if (typeid(*left) == typeid(Number) && typeid(*right) == typeid(Number)) {
+  if (left.is_number() && right.is_number()) {
     return;
   }
 
   throw RuntimeError(op, "Operands must be numbers.");
 }
 
-void Interpreter::interpret(vector<shared_ptr<Stmt>> statements) {
+void Interpreter::interpret(const vector<shared_ptr<Stmt>> &statements) {
   try {
-    for (shared_ptr<Stmt> statement : statements) {
+    for (const shared_ptr<Stmt> &statement : statements) {
       execute(statement);
     }
   } catch (RuntimeError &error) {
+    locals.clear();
+    frames.clear();
     Vm::runtime_error(error.op, error.message);
   }
 }
 
-void Interpreter::execute(shared_ptr<Stmt> stmt) { stmt->accept(this); }
-
-string Interpreter::stringify(shared_ptr<Object> object) {
-  if (object == nullptr) {
-    return "nil";
-  }
-
-  return object->to_string();
+void Interpreter::execute(const shared_ptr<Stmt> &stmt) {
+  // Expression temporaries never outlive a statement, so every live value is
+  // in globals or locals here.
+  Heap::instance().safepoint();
+  stmt->accept(this);
 }
 
-void Interpreter::visitExpressionStmt(Expression stmt) {
+string Interpreter::stringify(const Value &value) { return value.to_string(); }
+
+void Interpreter::visitExpressionStmt(Expression &stmt) {
   evaluate(stmt.expr);
   return;
 }
 
-void Interpreter::visitPrintStmt(Print stmt) {
-  shared_ptr<Object> value = evaluate(stmt.expr);
-  cout << stringify(value) << endl;
+void Interpreter::visitPrintStmt(Print &stmt) {
+  Value value = evaluate(stmt.expr);
+  Session::current().out << stringify(value) << endl;
   return;
 }
 
-shared_ptr<Object> Interpreter::visitVariableExpr(Variable expr) {
-  return environment->get(expr.name);
+Value Interpreter::visitVariableExpr(Variable &expr) {
+  if (expr.depth == -1) {
+    const Value *value = globals.get(global(expr.name, expr.global));
+
+    if (value == nullptr) {
+      throw RuntimeError(expr.name, "Undefined variable '" +
+                                        std::string(expr.name.lexeme()) +
+                                        "'.");
+    }
+
+    return *value;
+  }
+
+  return local(expr.depth, expr.slot);
+}
+
+Value &Interpreter::local(int depth, int slot) {
+  return locals[frames[frames.size() - 1 - depth] + slot];
 }
 
-void Interpreter::visitVarStmt(Var stmt) {
-  shared_ptr<Object> value = nullptr;
+// A tree the Resolver laid out in globals knows its slots. Others are looked
+// up by name, rather than cached in the tree, which may be running on other
+// threads against environments of their own.
+int Interpreter::global(const Token &name, int slot) {
+  if (slot == -1) {
+    return globals.slot(std::string(name.lexeme()));
+  }
+
+  return slot;
+}
+
+void Interpreter::visitVarStmt(Var &stmt) {
+  Value value;
 
   if (stmt.initializer != nullptr) {
     value = evaluate(stmt.initializer);
   }
 
-  environment->define(stmt.name.lexeme, value);
+  if (stmt.slot == -1) {
+    globals.define(global(stmt.name, stmt.global), value);
+  } else if (!stmt.redeclaration) {
+    local(0, stmt.slot) = value;
+  }
+
   return;
 }
 
-shared_ptr<Object> Interpreter::visitAssignExpr(Assign expr) {
-  shared_ptr<Object> value = evaluate(expr.value);
-  environment->assign(expr.name, value);
+Value Interpreter::visitAssignExpr(Assign &expr) {
+  Value value = evaluate(expr.value);
+  if (expr.depth == -1) {
+    if (!globals.assign(global(expr.name, expr.global), value)) {
+      throw RuntimeError(expr.name, "Undefined variable '" +
+                                        std::string(expr.name.lexeme()) +
+                                        "'.");
+    }
+  } else {
+    local(expr.depth, expr.slot) = value;
+  }
+
   return value;
 }
 
-void Interpreter::visitBlockStmt(Block stmt) {
-  execute_block(stmt.statements,
-                make_shared<Environment>(Environment(environment)));
+void Interpreter::visitBlockStmt(Block &stmt) {
+  execute_block(stmt.statements, stmt.locals);
   return;
 }
 
-void Interpreter::execute_block(vector<shared_ptr<Stmt>> statements,
-                                shared_ptr<Environment> environment) {
-  shared_ptr<Environment> previous = this->environment;
+void Interpreter::execute_block(const vector<shared_ptr<Stmt>> &statements,
+                                int locals) {
+  size_t base = this->locals.size();
 
-  this->environment = environment;
+  frames.push_back(base);
+  this->locals.resize(base + locals);
 
-  for (shared_ptr<Stmt> statement : statements) {
+  for (const shared_ptr<Stmt> &statement : statements) {
     execute(statement);
   }
 
-  this->environment = previous;
+  this->locals.resize(base);
+  frames.pop_back();
 }
 
-void Interpreter::visitIfStmt(If stmt) {
+void Interpreter::visitIfStmt(If &stmt) {
   if (is_truthy(evaluate(stmt.condition))) {
     execute(stmt.then_branch);
   } else if (stmt.else_branch != nullptr) {
@@ -206,8 +347,8 @@ void Interpreter::visitIfStmt(If stmt) {
   return;
 }
 
-shared_ptr<Object> Interpreter::visitLogicalExpr(Logical expr) {
-  shared_ptr<Object> left = evaluate(expr.left);
+Value Interpreter::visitLogicalExpr(Logical &expr) {
+  Value left = evaluate(expr.left);
 
   if (expr.op.type == TokenType::OR) {
     if (is_truthy(left))
@@ -220,10 +361,240 @@ shared_ptr<Object> Interpreter::visitLogicalExpr(Logical expr) {
   return evaluate(expr.right);
 }
 
-void Interpreter::visitWhileStmt(While stmt) {
+void Interpreter::visitWhileStmt(While &stmt) {
+  int iterations = 0;
+
   while (is_truthy(evaluate(stmt.condition))) {
     execute(stmt.body);
+
+    if (++iterations == Jit::threshold && Jit::enabled && run_native(stmt)) {
+      return;
+    }
   }
 
   return;
 }
+
+// Runs the rest of a hot loop as native code, compiling it the first time.
+// Returns false, leaving the loop to the caller, when the Jit does not
+// support the loop or a variable it uses does not hold a number right now.
+bool Interpreter::run_native(While &stmt) {
+  call_once(stmt.jit_once, [&stmt]() { stmt.native = Jit().compile(stmt); });
+
+  if (stmt.native == nullptr) {
+    return false;
+  }
+
+  const vector<NativeLoop::Binding> &bindings = stmt.native->bindings;
+  vector<double> slots(bindings.size());
+
+  for (size_t i = 0; i < bindings.size(); i++) {
+    const NativeLoop::Binding &binding = bindings[i];
+    const Value *value = nullptr;
+
+    switch (binding.kind) {
+    case NativeLoop::Kind::GLOBAL:
+      value = globals.get(globals.slot(binding.name));
+      break;
+    case NativeLoop::Kind::LOCAL:
+      value = &local(binding.depth, binding.slot);
+      break;
+    case NativeLoop::Kind::CONSTANT:
+      slots[i] = binding.constant;
+      continue;
+    case NativeLoop::Kind::SCRATCH:
+      continue;
+    }
+
+    if (value == nullptr || !value->is_number()) {
+      return false;
+    }
+
+    slots[i] = value->as_number();
+  }
+
+  stmt.native->run(slots.data());
+
+  for (size_t i = 0; i < bindings.size(); i++) {
+    const NativeLoop::Binding &binding = bindings[i];
+
+    if (!binding.assigned) {
+      continue;
+    }
+
+    if (binding.kind == NativeLoop::Kind::GLOBAL) {
+      globals.assign(globals.slot(binding.name), Value(slots[i]));
+    } else if (binding.kind == NativeLoop::Kind::LOCAL) {
+      local(binding.depth, binding.slot) = Value(slots[i]);
+    }
+  }
+
+  return true;
+}
+
+Value CountingInterpreter::visitLiteralExpr(Literal &expr) {
+  Stats::literal++;
+  return Interpreter::visitLiteralExpr(expr);
+}
+
+Value CountingInterpreter::visitGroupingExpr(Grouping &expr) {
+  Stats::grouping++;
+  return Interpreter::visitGroupingExpr(expr);
+}
+
+Value CountingInterpreter::visitUnaryExpr(Unary &expr) {
+  Stats::unary++;
+  return Interpreter::visitUnaryExpr(expr);
+}
+
+Value CountingInterpreter::visitBinaryExpr(Binary &expr) {
+  Stats::binary++;
+  return Interpreter::visitBinaryExpr(expr);
+}
+
+Value CountingInterpreter::visitVariableExpr(Variable &expr) {
+  Stats::variable++;
+  count_lookup(expr.depth);
+  return Interpreter::visitVariableExpr(expr);
+}
+
+Value CountingInterpreter::visitAssignExpr(Assign &expr) {
+  Stats::assign++;
+  count_lookup(expr.depth);
+  return Interpreter::visitAssignExpr(expr);
+}
+
+Value CountingInterpreter::visitLogicalExpr(Logical &expr) {
+  Stats::logical++;
+  return Interpreter::visitLogicalExpr(expr);
+}
+
+void CountingInterpreter::visitExpressionStmt(Expression &stmt) {
+  Stats::statements++;
+  Interpreter::visitExpressionStmt(stmt);
+}
+
+void CountingInterpreter::visitPrintStmt(Print &stmt) {
+  Stats::statements++;
+  Interpreter::visitPrintStmt(stmt);
+}
+
+void CountingInterpreter::visitVarStmt(Var &stmt) {
+  Stats::statements++;
+  Interpreter::visitVarStmt(stmt);
+}
+
+void CountingInterpreter::visitBlockStmt(Block &stmt) {
+  Stats::statements++;
+  Stats::scopes++;
+  Interpreter::visitBlockStmt(stmt);
+}
+
+void CountingInterpreter::visitIfStmt(If &stmt) {
+  Stats::statements++;
+  Interpreter::visitIfStmt(stmt);
+}
+
+void CountingInterpreter::visitWhileStmt(While &stmt) {
+  Stats::statements++;
+  Interpreter::visitWhileStmt(stmt);
+}
+
+void CountingInterpreter::count_lookup(int depth) {
+  if (depth == -1) {
+    Stats::global_lookups++;
+  } else {
+    Stats::local_lookups++;
+    Stats::scope_hops += static_cast<size_t>(depth);
+  }
+}
+
+// The environment goes away with the interpreter; its peak stays.
+HeapAccountingInterpreter::~HeapAccountingInterpreter() {
+  measure_environment();
+  HeapStats::measure(HeapStats::Category::ENVIRONMENT, 0, 0);
+}
+
+void HeapAccountingInterpreter::visitExpressionStmt(Expression &stmt) {
+  HeapStats::Line line(stmt.line);
+  poll();
+  Interpreter::visitExpressionStmt(stmt);
+}
+
+void HeapAccountingInterpreter::visitPrintStmt(Print &stmt) {
+  HeapStats::Line line(stmt.line);
+  poll();
+  Interpreter::visitPrintStmt(stmt);
+}
+
+void HeapAccountingInterpreter::visitVarStmt(Var &stmt) {
+  HeapStats::Line line(stmt.line);
+  poll();
+  Interpreter::visitVarStmt(stmt);
+}
+
+void HeapAccountingInterpreter::visitIfStmt(If &stmt) {
+  HeapStats::Line line(stmt.line);
+  poll();
+  Interpreter::visitIfStmt(stmt);
+}
+
+void HeapAccountingInterpreter::visitWhileStmt(While &stmt) {
+  HeapStats::Line line(stmt.line);
+  poll();
+  Interpreter::visitWhileStmt(stmt);
+}
+
+void ProfilingInterpreter::visitExpressionStmt(Expression &stmt) {
+  Profiler::enter(stmt.line, Profiler::Kind::EXPRESSION);
+  Interpreter::visitExpressionStmt(stmt);
+}
+
+void ProfilingInterpreter::visitPrintStmt(Print &stmt) {
+  Profiler::enter(stmt.line, Profiler::Kind::PRINT);
+  Interpreter::visitPrintStmt(stmt);
+}
+
+void ProfilingInterpreter::visitVarStmt(Var &stmt) {
+  Profiler::enter(stmt.line, Profiler::Kind::VAR);
+  Interpreter::visitVarStmt(stmt);
+}
+
+void ProfilingInterpreter::visitBlockStmt(Block &stmt) {
+  Profiler::Frame frame(stmt.line, Profiler::Kind::BLOCK);
+  Interpreter::visitBlockStmt(stmt);
+}
+
+void ProfilingInterpreter::visitIfStmt(If &stmt) {
+  Profiler::Frame frame(stmt.line, Profiler::Kind::IF);
+  Interpreter::visitIfStmt(stmt);
+}
+
+void ProfilingInterpreter::visitWhileStmt(While &stmt) {
+  Profiler::Frame frame(stmt.line, Profiler::Kind::WHILE);
+  Interpreter::visitWhileStmt(stmt);
+}
+
+EvaluatingInterpreter::EvaluatingInterpreter() {
+  Heap::instance().add_roots(&result);
+}
+
+EvaluatingInterpreter::~EvaluatingInterpreter() {
+  Heap::instance().remove_roots(&result);
+}
+
+void EvaluatingInterpreter::visitExpressionStmt(Expression &stmt) {
+  Value value = evaluate(stmt.expr);
+
+  if (&stmt == last) {
+    result[0] = value;
+  }
+}
+
+Value EvaluatingInterpreter::evaluate_program(
+    const vector<shared_ptr<Stmt>> &statements) {
+  last = statements.empty() ? nullptr : statements.back().get();
+  result[0] = Value();
+  interpret(statements);
+  return result[0];
+}
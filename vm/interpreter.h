@@ -1,52 +1,168 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
-#include "literals/boolean.h"
-#include "literals/number.h"
-#include "literals/object.h"
+#include "literals/heap.h"
+#include "literals/string.h"
+#include "literals/value.h"
 #include "vm/environment.h"
 #include "vm/errors.h"
 #include "vm/expr.h"
+#include "vm/heap_stats.h"
+#include "vm/jit.h"
+#include "vm/profiler.h"
+#include "vm/stats.h"
 #include "vm/stmt.h"
 #include "vm/vm.h"
+#include <ostream>
 #include <string>
-#include <typeinfo>
 
 using namespace std;
 
-class Interpreter : public Visitor<shared_ptr<Object>>,
-                    public StmtVisitor<void> {
+// How many Binary and Unary sites the Interpreters specialized, and how many
+// of those were deoptimized back to the generic code when their guard failed.
+struct FeedbackStats {
+  size_t specialized = 0;
+  size_t deoptimized = 0;
+
+  void report(ostream &out) const;
+};
+
+class Interpreter : public Visitor<Value>, public StmtVisitor<void> {
+public:
+  Interpreter();
+  virtual ~Interpreter();
+  Interpreter(const Interpreter &) = delete;
+  Interpreter &operator=(const Interpreter &) = delete;
+
+  Value visitLiteralExpr(Literal &expr);
+  Value visitGroupingExpr(Grouping &expr);
+  Value visitUnaryExpr(Unary &expr);
+  Value visitBinaryExpr(Binary &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  Value visitVariableExpr(Variable &expr);
+  Value visitAssignExpr(Assign &expr);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  Value visitLogicalExpr(Logical &expr);
+  void visitWhileStmt(While &stmt);
+
+  static thread_local FeedbackStats feedback;
+
+  void interpret(const vector<shared_ptr<Stmt>> &statements);
+  // The top level variables, for snapshots.
+  Environment &global_environment() { return globals; }
+  const Environment &global_environment() const { return globals; }
+  void execute_block(const vector<shared_ptr<Stmt>> &statements, int locals);
+
+protected:
+  // Reports the globals and local frames to HeapStats.
+  void measure_environment() const;
+  Value evaluate(const shared_ptr<Expr> &expr);
+
+private:
+  Environment globals;
+  // Block locals of every active block, innermost last, addressed through the
+  // (depth, slot) pairs computed by the Resolver. frames holds the index of
+  // each active block's first slot. Both keep their capacity between blocks,
+  // so entering a block does not allocate.
+  vector<Value> locals;
+  vector<size_t> frames;
+
+  Value &local(int depth, int slot);
+  int global(const Token &name, int slot);
+  Value generic_binary(const Binary &expr, const Value &left,
+                       const Value &right);
+  static Specialization specialize(TokenType op, const Value &left,
+                                   const Value &right);
+  bool is_truthy(const Value &value);
+  bool is_equal(const Value &a, const Value &b);
+  void check_number_operand(Token op, const Value &operand);
+  void check_number_operands(Token op, const Value &left, const Value &right);
+  string stringify(const Value &value);
+  void execute(const shared_ptr<Stmt> &stmt);
+  bool run_native(While &stmt);
+};
+
+// Interpreter that also keeps the execution counters of --stats. The counting
+// is all in this subclass, so the plain Interpreter pays nothing for it.
+class CountingInterpreter final : public Interpreter {
+public:
+  Value visitLiteralExpr(Literal &expr);
+  Value visitGroupingExpr(Grouping &expr);
+  Value visitUnaryExpr(Unary &expr);
+  Value visitBinaryExpr(Binary &expr);
+  Value visitVariableExpr(Variable &expr);
+  Value visitAssignExpr(Assign &expr);
+  Value visitLogicalExpr(Logical &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  static void count_lookup(int depth);
+};
+
+// Interpreter that charges runtime allocations to the executing statement's
+// line and takes the periodic snapshots of --heap-stats.
+class HeapAccountingInterpreter final : public Interpreter {
+public:
+  ~HeapAccountingInterpreter();
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  // Blocks allocate nothing themselves and are left alone.
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  size_t statements = 0;
+
+  // Polls for a snapshot every so many statements, to keep the clock reads
+  // rare.
+  void poll() {
+    if ((++statements & 1023) == 0) {
+      measure_environment();
+      HeapStats::poll();
+    }
+  }
+};
+
+// Interpreter that keeps the Profiler's stack of executing statements up to
+// date, for --profile.
+class ProfilingInterpreter final : public Interpreter {
+public:
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+};
+
+// Interpreter that keeps the value of a program's last statement, when it is
+// an expression statement, as the result of a Context::evaluate. The value is
+// a Heap root until the next program runs.
+class EvaluatingInterpreter final : public Interpreter {
 public:
-  shared_ptr<Object> visitLiteralExpr(Literal expr);
-  shared_ptr<Object> visitGroupingExpr(Grouping expr);
-  shared_ptr<Object> visitUnaryExpr(Unary expr);
-  shared_ptr<Object> visitBinaryExpr(Binary expr);
-
-  void visitVarStmt(Var stmt);
-  shared_ptr<Object> visitVariableExpr(Variable expr);
-  shared_ptr<Object> visitAssignExpr(Assign expr);
-  void visitBlockStmt(Block stmt);
-  void visitIfStmt(If stmt);
-  shared_ptr<Object> visitLogicalExpr(Logical expr);
-  void visitWhileStmt(While stmt);
-
-  void interpret(vector<shared_ptr<Stmt>> statements);
-  void execute_block(vector<shared_ptr<Stmt>> statements,
-                     shared_ptr<Environment> environment);
+  EvaluatingInterpreter();
+  ~EvaluatingInterpreter();
+
+  void visitExpressionStmt(Expression &stmt);
+
+  // Interprets statements and returns their result, or nil.
+  Value evaluate_program(const vector<shared_ptr<Stmt>> &statements);
 
 private:
-  shared_ptr<Environment> environment = make_shared<Environment>(Environment());
-
-  shared_ptr<Object> evaluate(shared_ptr<Expr> expr);
-  bool is_truthy(shared_ptr<Object> obj);
-  bool is_equal(shared_ptr<Object> a, shared_ptr<Object> b);
-  void check_number_operand(Token op, shared_ptr<Object> operand);
-  void check_number_operands(Token op, shared_ptr<Object> left,
-                             shared_ptr<Object> right);
-  string stringify(shared_ptr<Object> object);
-  void visitExpressionStmt(Expression stmt);
-  void visitPrintStmt(Print stmt);
-  void execute(shared_ptr<Stmt> stmt);
+  const Stmt *last = nullptr;
+  vector<Value> result = vector<Value>(1);
 };
 
 #endif
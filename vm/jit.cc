@@ -0,0 +1,419 @@
+#include "vm/jit.h"
+#include <cstring>
+#include <sys/mman.h>
+
+bool Jit::enabled = true;
+int Jit::threshold = 100;
+
+// Condition bytes of the "0F 8x rel32" jumps, after ucomisd. JMP stands for
+// the unconditional "E9 rel32".
+static constexpr uint8_t JMP = 0x00;
+static constexpr uint8_t JB = 0x82;
+static constexpr uint8_t JAE = 0x83;
+static constexpr uint8_t JE = 0x84;
+static constexpr uint8_t JNE = 0x85;
+static constexpr uint8_t JBE = 0x86;
+static constexpr uint8_t JA = 0x87;
+static constexpr uint8_t JP = 0x8A;
+
+// Scalar double SSE2 instructions, by prefix and opcode.
+static constexpr uint8_t SD = 0xF2;
+static constexpr uint8_t PD = 0x66;
+static constexpr uint8_t MOVSD_LOAD = 0x10;
+static constexpr uint8_t MOVSD_STORE = 0x11;
+static constexpr uint8_t UCOMISD = 0x2E;
+static constexpr uint8_t XORPD = 0x57;
+static constexpr uint8_t ADDSD = 0x58;
+static constexpr uint8_t MULSD = 0x59;
+static constexpr uint8_t SUBSD = 0x5C;
+static constexpr uint8_t DIVSD = 0x5E;
+
+NativeLoop::NativeLoop(void *code, size_t size, vector<Binding> bindings)
+    : bindings(std::move(bindings)), code(code), size(size) {}
+
+NativeLoop::~NativeLoop() { munmap(code, size); }
+
+void NativeLoop::run(double *slots) const {
+  reinterpret_cast<void (*)(double *)>(code)(slots);
+}
+
+bool Jit::is_supported() {
+#if defined(__x86_64__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+shared_ptr<NativeLoop> Jit::compile(While &loop) {
+  if (!is_supported()) {
+    return nullptr;
+  }
+
+  visitWhileStmt(loop);
+  emit({0xC3});
+
+  if (!supported) {
+    return nullptr;
+  }
+
+  // Written while writable, then switched to executable, so the buffer is
+  // never both at once.
+  size_t size = code.size();
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+
+  memcpy(memory, code.data(), size);
+
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return nullptr;
+  }
+
+  return make_shared<NativeLoop>(memory, size, std::move(bindings));
+}
+
+void Jit::value(const shared_ptr<Expr> &expr, int reg) {
+  if (reg >= REGISTERS) {
+    supported = false;
+    return;
+  }
+
+  int enclosing = target;
+  target = reg;
+  expr->accept(this);
+  target = enclosing;
+}
+
+// Emits jumps, added to jumps, taken when the truthiness of expr is sense.
+void Jit::jump_if(const shared_ptr<Expr> &expr, bool sense,
+                  vector<size_t> &jumps) {
+  if (const Grouping *grouping = dynamic_cast<Grouping *>(expr.get())) {
+    jump_if(grouping->expression, sense, jumps);
+    return;
+  }
+
+  const Unary *unary = dynamic_cast<Unary *>(expr.get());
+
+  if (unary != nullptr && unary->op.type == TokenType::BANG) {
+    jump_if(unary->right, !sense, jumps);
+    return;
+  }
+
+  // "or" is decided by the first truthy operand and "and" by the first falsy
+  // one; the other outcome needs both operands.
+  if (const Logical *logical = dynamic_cast<Logical *>(expr.get())) {
+    if (sense == (logical->op.type == TokenType::OR)) {
+      jump_if(logical->left, sense, jumps);
+      jump_if(logical->right, sense, jumps);
+    } else {
+      vector<size_t> decided;
+      jump_if(logical->left, !sense, decided);
+      jump_if(logical->right, sense, jumps);
+      patch(decided, code.size());
+    }
+
+    return;
+  }
+
+  if (const Literal *literal = dynamic_cast<Literal *>(expr.get())) {
+    if (literal->value.is_truthy() == sense) {
+      jumps.push_back(emit_jump(JMP));
+    }
+
+    return;
+  }
+
+  const Binary *binary = dynamic_cast<Binary *>(expr.get());
+
+  if (binary != nullptr && binary->op.type != TokenType::PLUS &&
+      binary->op.type != TokenType::MINUS &&
+      binary->op.type != TokenType::STAR &&
+      binary->op.type != TokenType::SLASH) {
+    compare(*binary, sense, jumps);
+    return;
+  }
+
+  // Anything else is a number, which is always truthy.
+  value(expr, 0);
+
+  if (sense) {
+    jumps.push_back(emit_jump(JMP));
+  }
+}
+
+// ucomisd sets CF for "below" and ZF for "equal", and all of ZF, PF and CF
+// when either operand is NaN. "a < b" is tested as "b > a" so that NaN is
+// false for every ordering, as in the Interpreter.
+void Jit::compare(const Binary &expr, bool sense, vector<size_t> &jumps) {
+  value(expr.left, 0);
+  value(expr.right, 1);
+
+  switch (expr.op.type) {
+  case TokenType::GREATER:
+    emit_sse(PD, UCOMISD, 0, 1);
+    jumps.push_back(emit_jump(sense ? JA : JBE));
+    return;
+  case TokenType::GREATER_EQUAL:
+    emit_sse(PD, UCOMISD, 0, 1);
+    jumps.push_back(emit_jump(sense ? JAE : JB));
+    return;
+  case TokenType::LESS:
+    emit_sse(PD, UCOMISD, 1, 0);
+    jumps.push_back(emit_jump(sense ? JA : JBE));
+    return;
+  case TokenType::LESS_EQUAL:
+    emit_sse(PD, UCOMISD, 1, 0);
+    jumps.push_back(emit_jump(sense ? JAE : JB));
+    return;
+  case TokenType::EQUAL_EQUAL:
+  case TokenType::BANG_EQUAL:
+    emit_sse(PD, UCOMISD, 0, 1);
+
+    if ((expr.op.type == TokenType::EQUAL_EQUAL) == sense) {
+      size_t unordered = emit_jump(JP);
+      jumps.push_back(emit_jump(JE));
+      patch(unordered, code.size());
+    } else {
+      jumps.push_back(emit_jump(JP));
+      jumps.push_back(emit_jump(JNE));
+    }
+
+    return;
+  default:
+    supported = false;
+    return;
+  }
+}
+
+// Slot of a variable as seen from blocks.size() blocks into the loop.
+int Jit::variable(const Token &name, int depth, int slot) {
+  int nesting = static_cast<int>(blocks.size());
+  NativeLoop::Binding binding = {NativeLoop::Kind::GLOBAL, "", -1, -1, 0,
+                                 false};
+  tuple<int, int, int, string> key;
+
+  if (depth == -1) {
+    binding.name = string(name.lexeme());
+    key = {0, 0, 0, binding.name};
+  } else if (depth < nesting) {
+    binding.kind = NativeLoop::Kind::SCRATCH;
+    key = {1, blocks[nesting - 1 - depth], slot, ""};
+  } else {
+    binding.kind = NativeLoop::Kind::LOCAL;
+    binding.depth = depth - nesting;
+    binding.slot = slot;
+    key = {2, binding.depth, slot, ""};
+  }
+
+  auto existing = variable_slots.find(key);
+
+  if (existing != variable_slots.end()) {
+    return existing->second;
+  }
+
+  int index = static_cast<int>(bindings.size());
+  bindings.push_back(binding);
+  variable_slots.insert(pair<tuple<int, int, int, string>, int>(key, index));
+  return index;
+}
+
+int Jit::constant(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  auto existing = constant_slots.find(bits);
+
+  if (existing != constant_slots.end()) {
+    return existing->second;
+  }
+
+  int index = static_cast<int>(bindings.size());
+  bindings.push_back(NativeLoop::Binding{NativeLoop::Kind::CONSTANT, "", -1,
+                                         -1, value, false});
+  constant_slots.insert(pair<uint64_t, int>(bits, index));
+  return index;
+}
+
+void Jit::visitBinaryExpr(Binary &expr) {
+  uint8_t op;
+
+  switch (expr.op.type) {
+  case TokenType::PLUS:
+    op = ADDSD;
+    break;
+  case TokenType::MINUS:
+    op = SUBSD;
+    break;
+  case TokenType::STAR:
+    op = MULSD;
+    break;
+  case TokenType::SLASH:
+    op = DIVSD;
+    break;
+  default:
+    supported = false;
+    return;
+  }
+
+  int reg = target;
+  value(expr.left, reg);
+  value(expr.right, reg + 1);
+
+  if (supported) {
+    emit_sse(SD, op, reg, reg + 1);
+  }
+}
+
+void Jit::visitGroupingExpr(Grouping &expr) {
+  value(expr.expression, target);
+}
+
+void Jit::visitLiteralExpr(Literal &expr) {
+  if (!expr.value.is_number()) {
+    supported = false;
+    return;
+  }
+
+  emit_sse_slot(SD, MOVSD_LOAD, target, constant(expr.value.as_number()));
+}
+
+// Negation flips the sign bit, so that -0 is -0 as in the Interpreter.
+void Jit::visitUnaryExpr(Unary &expr) {
+  int reg = target;
+
+  if (expr.op.type != TokenType::MINUS || reg + 1 >= REGISTERS) {
+    supported = false;
+    return;
+  }
+
+  value(expr.right, reg);
+  emit_sse_slot(SD, MOVSD_LOAD, reg + 1, constant(-0.0));
+  emit_sse(PD, XORPD, reg, reg + 1);
+}
+
+void Jit::visitVariableExpr(Variable &expr) {
+  emit_sse_slot(SD, MOVSD_LOAD, target,
+                variable(expr.name, expr.depth, expr.slot));
+}
+
+void Jit::visitAssignExpr(Assign &expr) {
+  value(expr.value, target);
+  int slot = variable(expr.name, expr.depth, expr.slot);
+  bindings[slot].assigned = true;
+  emit_sse_slot(SD, MOVSD_STORE, target, slot);
+}
+
+void Jit::visitLogicalExpr(Logical &expr) { supported = false; }
+
+void Jit::visitExpressionStmt(Expression &stmt) { value(stmt.expr, 0); }
+
+void Jit::visitPrintStmt(Print &stmt) { supported = false; }
+
+void Jit::visitVarStmt(Var &stmt) {
+  if (stmt.slot == -1 || stmt.initializer == nullptr || blocks.empty()) {
+    supported = false;
+    return;
+  }
+
+  value(stmt.initializer, 0);
+
+  if (!stmt.redeclaration) {
+    int slot = variable(stmt.name, 0, stmt.slot);
+    emit_sse_slot(SD, MOVSD_STORE, 0, slot);
+  }
+}
+
+void Jit::visitBlockStmt(Block &stmt) {
+  blocks.push_back(next_block++);
+
+  for (const shared_ptr<Stmt> &statement : stmt.statements) {
+    statement->accept(this);
+  }
+
+  blocks.pop_back();
+}
+
+void Jit::visitIfStmt(If &stmt) {
+  vector<size_t> otherwise;
+  jump_if(stmt.condition, false, otherwise);
+  stmt.then_branch->accept(this);
+
+  if (stmt.else_branch == nullptr) {
+    patch(otherwise, code.size());
+    return;
+  }
+
+  size_t end = emit_jump(JMP);
+  patch(otherwise, code.size());
+  stmt.else_branch->accept(this);
+  patch(end, code.size());
+}
+
+void Jit::visitWhileStmt(While &stmt) {
+  size_t start = code.size();
+  vector<size_t> exits;
+  jump_if(stmt.condition, false, exits);
+  stmt.body->accept(this);
+  patch(emit_jump(JMP), start);
+  patch(exits, code.size());
+}
+
+void Jit::emit(initializer_list<uint8_t> bytes) {
+  code.insert(code.end(), bytes);
+}
+
+// reg, rm: register operands.
+void Jit::emit_sse(uint8_t prefix, uint8_t op, int reg, int rm) {
+  code.push_back(prefix);
+
+  if (reg >= 8 || rm >= 8) {
+    code.push_back(0x40 | (reg >= 8 ? 0x04 : 0) | (rm >= 8 ? 0x01 : 0));
+  }
+
+  emit({0x0F, op, static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7))});
+}
+
+// reg, [rdi + 8 * slot].
+void Jit::emit_sse_slot(uint8_t prefix, uint8_t op, int reg, int slot) {
+  code.push_back(prefix);
+
+  if (reg >= 8) {
+    code.push_back(0x44);
+  }
+
+  emit({0x0F, op, static_cast<uint8_t>(0x87 | (reg & 7) << 3)});
+
+  uint32_t displacement = static_cast<uint32_t>(slot) * 8;
+
+  for (int i = 0; i < 4; i++) {
+    code.push_back(static_cast<uint8_t>(displacement >> (8 * i)));
+  }
+}
+
+// Returns the offset of the rel32 operand, to be patched.
+size_t Jit::emit_jump(uint8_t condition) {
+  if (condition == JMP) {
+    code.push_back(0xE9);
+  } else {
+    emit({0x0F, condition});
+  }
+
+  size_t jump = code.size();
+  emit({0, 0, 0, 0});
+  return jump;
+}
+
+void Jit::patch(const vector<size_t> &jumps, size_t to) {
+  for (size_t jump : jumps) {
+    patch(jump, to);
+  }
+}
+
+void Jit::patch(size_t jump, size_t to) {
+  int32_t offset = static_cast<int32_t>(to - (jump + 4));
+  memcpy(&code[jump], &offset, sizeof(offset));
+}
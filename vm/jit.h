@@ -0,0 +1,117 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "literals/value.h"
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include "vm/token.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+// Machine code for one While statement, condition included. The code runs
+// the loop to completion on unboxed doubles: every variable and constant the
+// loop touches has a slot in an array of doubles whose address is the only
+// argument.
+class NativeLoop final {
+public:
+  enum class Kind { GLOBAL, LOCAL, SCRATCH, CONSTANT };
+
+  // What a slot holds. GLOBAL slots are looked up by name, LOCAL slots by the
+  // (depth, slot) pair of the block around the loop, SCRATCH slots are locals
+  // declared inside the loop and CONSTANT slots are filled with constant.
+  struct Binding {
+    Kind kind;
+    string name;
+    int depth;
+    int slot;
+    double constant;
+    bool assigned;
+  };
+
+  NativeLoop(void *code, size_t size, vector<Binding> bindings);
+  ~NativeLoop();
+  NativeLoop(const NativeLoop &) = delete;
+  NativeLoop &operator=(const NativeLoop &) = delete;
+
+  void run(double *slots) const;
+
+  const vector<Binding> bindings;
+
+private:
+  void *code;
+  size_t size;
+};
+
+// Baseline x86-64 compiler for hot numeric loops, used by the Interpreter.
+//
+// Only loops made of Binary, Unary, Grouping, Assign, Variable and number
+// literals under Expression, Var, Block, If and While statements are
+// supported, and every value has to be a number: comparisons, "!", "and" and
+// "or" may only appear as conditions. Anything else makes compile() return
+// nullptr and the loop keeps running in the Interpreter. Since a loop like
+// that can only ever produce numbers, checking that the variables it reads
+// hold numbers when it is entered is the only guard needed.
+//
+// Values are kept in xmm registers used as an expression stack, so an
+// expression needing more than 16 of them is not supported either.
+class Jit final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  // Settings read by the Interpreter. threshold is the number of iterations
+  // a loop runs in the Interpreter before it is compiled.
+  static bool enabled;
+  static int threshold;
+
+  static bool is_supported();
+  shared_ptr<NativeLoop> compile(While &loop);
+
+  void visitBinaryExpr(Binary &expr);
+  void visitGroupingExpr(Grouping &expr);
+  void visitLiteralExpr(Literal &expr);
+  void visitUnaryExpr(Unary &expr);
+  void visitVariableExpr(Variable &expr);
+  void visitAssignExpr(Assign &expr);
+  void visitLogicalExpr(Logical &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  static constexpr int REGISTERS = 16;
+
+  vector<uint8_t> code;
+  vector<NativeLoop::Binding> bindings;
+  map<tuple<int, int, int, string>, int> variable_slots;
+  map<uint64_t, int> constant_slots;
+  // Blocks entered inside the loop, innermost last, by id.
+  vector<int> blocks;
+  int next_block = 0;
+  // Register the expression being visited leaves its value in.
+  int target = 0;
+  bool supported = true;
+
+  void value(const shared_ptr<Expr> &expr, int reg);
+  void jump_if(const shared_ptr<Expr> &expr, bool sense,
+               vector<size_t> &jumps);
+  void compare(const Binary &expr, bool sense, vector<size_t> &jumps);
+  int variable(const Token &name, int depth, int slot);
+  int constant(double value);
+
+  void emit(initializer_list<uint8_t> bytes);
+  void emit_sse(uint8_t prefix, uint8_t op, int reg, int rm);
+  void emit_sse_slot(uint8_t prefix, uint8_t op, int reg, int slot);
+  size_t emit_jump(uint8_t condition);
+  void patch(const vector<size_t> &jumps, size_t to);
+  void patch(size_t jump, size_t to);
+};
+
+#endif
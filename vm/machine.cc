@@ -0,0 +1,218 @@
+#include "vm/machine.h"
+
+Machine::Machine() {
+  Heap::instance().add_roots(&stack);
+  Heap::instance().add_roots(&globals);
+}
+
+Machine::~Machine() {
+  Heap::instance().remove_roots(&stack);
+  Heap::instance().remove_roots(&globals);
+}
+
+void Machine::interpret(const Chunk &chunk) {
+  this->chunk = &chunk;
+  this->ip = 0;
+  globals.resize(chunk.names.size());
+  defined.resize(chunk.names.size());
+
+  if (!run()) {
+    stack.clear();
+  }
+}
+
+bool Machine::run() {
+  while (true) {
+    OpCode instruction = static_cast<OpCode>(chunk->code[ip++]);
+
+    switch (instruction) {
+    case OpCode::CONSTANT:
+      push(chunk->constants[read_u32()]);
+      break;
+    case OpCode::NIL:
+      push(Value());
+      break;
+    case OpCode::POP:
+      stack.pop_back();
+      break;
+    case OpCode::GET_LOCAL:
+      push(stack[read_u16()]);
+      break;
+    case OpCode::SET_LOCAL:
+      stack[read_u16()] = peek(0);
+      break;
+    case OpCode::GET_GLOBAL: {
+      uint32_t global = read_u32();
+
+      if (!defined[global]) {
+        runtime_error("Undefined variable '" + chunk->names[global] + "'.");
+        return false;
+      }
+
+      push(globals[global]);
+      break;
+    }
+    case OpCode::DEFINE_GLOBAL: {
+      uint32_t global = read_u32();
+
+      // Redefining a variable keeps its first value.
+      if (!defined[global]) {
+        globals[global] = peek(0);
+        defined[global] = true;
+      }
+
+      stack.pop_back();
+      break;
+    }
+    case OpCode::SET_GLOBAL: {
+      uint32_t global = read_u32();
+
+      if (!defined[global]) {
+        runtime_error("Undefined variable '" + chunk->names[global] + "'.");
+        return false;
+      }
+
+      globals[global] = peek(0);
+      break;
+    }
+    case OpCode::EQUAL: {
+      Value b = pop();
+      Value a = pop();
+      push(Value(a == b));
+      break;
+    }
+    case OpCode::NOT_EQUAL: {
+      Value b = pop();
+      Value a = pop();
+      push(Value(a != b));
+      break;
+    }
+    case OpCode::GREATER:
+    case OpCode::GREATER_EQUAL:
+    case OpCode::LESS:
+    case OpCode::LESS_EQUAL:
+    case OpCode::SUBTRACT:
+    case OpCode::MULTIPLY:
+    case OpCode::DIVIDE: {
+      if (!binary_number_operands()) {
+        runtime_error("Operands must be numbers.");
+        return false;
+      }
+
+      double b = pop().as_number();
+      double a = pop().as_number();
+
+      switch (instruction) {
+      case OpCode::GREATER:
+        push(Value(a > b));
+        break;
+      case OpCode::GREATER_EQUAL:
+        push(Value(a >= b));
+        break;
+      case OpCode::LESS:
+        push(Value(a < b));
+        break;
+      case OpCode::LESS_EQUAL:
+        push(Value(a <= b));
+        break;
+      case OpCode::SUBTRACT:
+        push(Value(a - b));
+        break;
+      case OpCode::MULTIPLY:
+        push(Value(a * b));
+        break;
+      default:
+        push(Value(a / b));
+        break;
+      }
+      break;
+    }
+    case OpCode::ADD: {
+      if (binary_number_operands()) {
+        double b = pop().as_number();
+        double a = pop().as_number();
+        push(Value(a + b));
+        break;
+      }
+
+      if (peek(0).is_string() && peek(1).is_string()) {
+        Value b = pop();
+        Value a = pop();
+        push(Value(String::concat(*a.as_string(), *b.as_string())));
+        // Concatenation is the only allocation, and every live value is on
+        // the stack or in globals between instructions.
+        Heap::instance().safepoint();
+        break;
+      }
+
+      runtime_error("Operands must be two numbers or two strings.");
+      return false;
+    }
+    case OpCode::NOT:
+      push(Value(!pop().is_truthy()));
+      break;
+    case OpCode::NEGATE:
+      if (!peek(0).is_number()) {
+        runtime_error("Operand must be a number.");
+        return false;
+      }
+
+      push(Value(-pop().as_number()));
+      break;
+    case OpCode::PRINT:
+      Session::current().out << pop().to_string() << endl;
+      break;
+    case OpCode::JUMP: {
+      uint32_t offset = read_u32();
+      ip += offset;
+      break;
+    }
+    case OpCode::JUMP_IF_FALSE: {
+      uint32_t offset = read_u32();
+
+      if (!peek(0).is_truthy())
+        ip += offset;
+      break;
+    }
+    case OpCode::LOOP: {
+      uint32_t offset = read_u32();
+      ip -= offset;
+      break;
+    }
+    case OpCode::RETURN:
+      return true;
+    }
+  }
+}
+
+void Machine::push(Value value) { stack.push_back(std::move(value)); }
+
+Value Machine::pop() {
+  Value value = std::move(stack.back());
+  stack.pop_back();
+  return value;
+}
+
+const Value &Machine::peek(size_t distance) {
+  return stack[stack.size() - 1 - distance];
+}
+
+uint16_t Machine::read_u16() {
+  uint16_t value = chunk->read_u16(ip);
+  ip += 2;
+  return value;
+}
+
+uint32_t Machine::read_u32() {
+  uint32_t value = chunk->read_u32(ip);
+  ip += 4;
+  return value;
+}
+
+bool Machine::binary_number_operands() {
+  return peek(0).is_number() && peek(1).is_number();
+}
+
+void Machine::runtime_error(const string &message) {
+  Vm::runtime_error(chunk->lines[ip - 1], message);
+}
@@ -0,0 +1,46 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "literals/heap.h"
+#include "literals/string.h"
+#include "literals/value.h"
+#include "vm/chunk.h"
+#include "vm/vm.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Stack based virtual machine running the Chunk produced by the Compiler.
+// Produces the same output and runtime errors as the tree walking
+// Interpreter.
+class Machine final {
+public:
+  Machine();
+  ~Machine();
+  Machine(const Machine &) = delete;
+  Machine &operator=(const Machine &) = delete;
+
+  void interpret(const Chunk &chunk);
+
+private:
+  const Chunk *chunk = nullptr;
+  size_t ip = 0;
+  vector<Value> stack;
+  // Globals are indexed by the chunk's name table, which the Compiler keeps
+  // free of duplicates.
+  vector<Value> globals;
+  vector<bool> defined;
+
+  bool run();
+  void push(Value value);
+  Value pop();
+  const Value &peek(size_t distance);
+  uint16_t read_u16();
+  uint32_t read_u32();
+  bool binary_number_operands();
+  void runtime_error(const string &message);
+};
+
+#endif
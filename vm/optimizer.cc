@@ -0,0 +1,284 @@
+#include "vm/optimizer.h"
+
+vector<shared_ptr<Stmt>>
+Optimizer::optimize(const vector<shared_ptr<Stmt>> &statements) {
+  if (level <= 0) {
+    return statements;
+  }
+
+  return optimize_block(statements, level >= 2);
+}
+
+shared_ptr<Expr> Optimizer::optimize(const shared_ptr<Expr> &expr) {
+  if (expr == nullptr) {
+    return nullptr;
+  }
+
+  expr_result = nullptr;
+  expr->accept(this);
+
+  shared_ptr<Expr> result = expr_result != nullptr ? expr_result : expr;
+  expr_result = nullptr;
+  return result;
+}
+
+shared_ptr<Stmt> Optimizer::optimize(const shared_ptr<Stmt> &stmt) {
+  if (stmt == nullptr) {
+    return nullptr;
+  }
+
+  stmt_result = nullptr;
+  stmt->accept(this);
+
+  shared_ptr<Stmt> result = stmt_result != nullptr ? stmt_result : stmt;
+  stmt_result = nullptr;
+
+  // Rebuilt statements keep the line of the one they replace.
+  if (result->line == 0) {
+    result->line = stmt->line;
+  }
+
+  return result;
+}
+
+vector<shared_ptr<Stmt>>
+Optimizer::optimize_block(const vector<shared_ptr<Stmt>> &statements,
+                          bool splice) {
+  vector<shared_ptr<Stmt>> result;
+  result.reserve(statements.size());
+
+  for (const shared_ptr<Stmt> &statement : statements) {
+    shared_ptr<Stmt> optimized = optimize(statement);
+
+    if (optimized != nullptr && is_empty(optimized)) {
+      continue;
+    }
+
+    Block *block = dynamic_cast<Block *>(optimized.get());
+
+    // A block that declares nothing only adds a scope nobody can see.
+    if (splice && block != nullptr) {
+      bool declares = false;
+
+      for (const shared_ptr<Stmt> &inner : block->statements) {
+        declares = declares || dynamic_cast<Var *>(inner.get()) != nullptr;
+      }
+
+      if (!declares) {
+        result.insert(result.end(), block->statements.begin(),
+                      block->statements.end());
+        continue;
+      }
+    }
+
+    result.push_back(optimized);
+  }
+
+  return result;
+}
+
+const Literal *Optimizer::constant(const shared_ptr<Expr> &expr) {
+  return dynamic_cast<const Literal *>(expr.get());
+}
+
+bool Optimizer::is_empty(const shared_ptr<Stmt> &stmt) {
+  const Block *block = dynamic_cast<const Block *>(stmt.get());
+  return block != nullptr && block->statements.empty();
+}
+
+// Mirrors Interpreter::visitBinaryExpr. Returns false, leaving the expression
+// for runtime, whenever the interpreter would raise an error.
+bool Optimizer::fold_binary(TokenType op, const Value &left, const Value &right,
+                            Value &result) {
+  if (op == TokenType::EQUAL_EQUAL || op == TokenType::BANG_EQUAL) {
+    result = Value((left == right) == (op == TokenType::EQUAL_EQUAL));
+    return true;
+  }
+
+  // A folded concatenation is a literal as far as the program can tell, so it
+  // is interned like one.
+  if (op == TokenType::PLUS && left.is_string() && right.is_string()) {
+    result = Value(StringTable::intern(left.as_string()->to_string() +
+                                       right.as_string()->to_string()));
+    return true;
+  }
+
+  if (!left.is_number() || !right.is_number()) {
+    return false;
+  }
+
+  double a = left.as_number();
+  double b = right.as_number();
+
+  switch (op) {
+  case TokenType::PLUS:
+    result = Value(a + b);
+    return true;
+  case TokenType::MINUS:
+    result = Value(a - b);
+    return true;
+  case TokenType::STAR:
+    result = Value(a * b);
+    return true;
+  case TokenType::SLASH:
+    result = Value(a / b);
+    return true;
+  case TokenType::GREATER:
+    result = Value(a > b);
+    return true;
+  case TokenType::GREATER_EQUAL:
+    result = Value(a >= b);
+    return true;
+  case TokenType::LESS:
+    result = Value(a < b);
+    return true;
+  case TokenType::LESS_EQUAL:
+    result = Value(a <= b);
+    return true;
+  default:
+    return false;
+  }
+}
+
+void Optimizer::visitBinaryExpr(Binary &expr) {
+  shared_ptr<Expr> left = optimize(expr.left);
+  shared_ptr<Expr> right = optimize(expr.right);
+  const Literal *a = constant(left);
+  const Literal *b = constant(right);
+  Value folded;
+
+  if (a != nullptr && b != nullptr &&
+      fold_binary(expr.op.type, a->value, b->value, folded)) {
+    expr_result = make_shared<Literal>(Literal(folded));
+  } else if (left != expr.left || right != expr.right) {
+    expr_result = make_shared<Binary>(left, expr.op, right);
+  }
+}
+
+void Optimizer::visitGroupingExpr(Grouping &expr) {
+  expr_result = optimize(expr.expression);
+}
+
+void Optimizer::visitLiteralExpr(Literal &expr) { return; }
+
+void Optimizer::visitUnaryExpr(Unary &expr) {
+  shared_ptr<Expr> right = optimize(expr.right);
+  const Literal *operand = constant(right);
+
+  if (operand != nullptr && expr.op.type == TokenType::BANG) {
+    Value folded = Value(!operand->value.is_truthy());
+    expr_result = make_shared<Literal>(Literal(folded));
+  } else if (operand != nullptr && expr.op.type == TokenType::MINUS &&
+             operand->value.is_number()) {
+    Value folded = Value(-operand->value.as_number());
+    expr_result = make_shared<Literal>(Literal(folded));
+  } else if (right != expr.right) {
+    expr_result = make_shared<Unary>(expr.op, right);
+  }
+}
+
+void Optimizer::visitVariableExpr(Variable &expr) { return; }
+
+void Optimizer::visitAssignExpr(Assign &expr) {
+  shared_ptr<Expr> value = optimize(expr.value);
+
+  if (value != expr.value) {
+    expr_result = make_shared<Assign>(Assign(expr.name, value));
+  }
+}
+
+void Optimizer::visitLogicalExpr(Logical &expr) {
+  shared_ptr<Expr> left = optimize(expr.left);
+  shared_ptr<Expr> right = optimize(expr.right);
+  const Literal *condition = constant(left);
+
+  // "or" yields its left operand when it is truthy, "and" when it is falsy,
+  // and both yield the right operand otherwise.
+  if (condition != nullptr) {
+    bool short_circuits = condition->value.is_truthy() ==
+                          (expr.op.type == TokenType::OR);
+    expr_result = short_circuits ? left : right;
+  } else if (left != expr.left || right != expr.right) {
+    expr_result = make_shared<Logical>(Logical(left, expr.op, right));
+  }
+}
+
+void Optimizer::visitExpressionStmt(Expression &stmt) {
+  shared_ptr<Expr> expr = optimize(stmt.expr);
+
+  if (level >= 2 && constant(expr) != nullptr) {
+    stmt_result = make_shared<Block>(Block({}));
+  } else if (expr != stmt.expr) {
+    stmt_result = make_shared<Expression>(Expression(expr));
+  }
+}
+
+void Optimizer::visitPrintStmt(Print &stmt) {
+  shared_ptr<Expr> expr = optimize(stmt.expr);
+
+  if (expr != stmt.expr) {
+    stmt_result = make_shared<Print>(Print(expr));
+  }
+}
+
+void Optimizer::visitVarStmt(Var &stmt) {
+  shared_ptr<Expr> initializer = optimize(stmt.initializer);
+
+  if (initializer != stmt.initializer) {
+    stmt_result = make_shared<Var>(Var(stmt.name, initializer));
+  }
+}
+
+void Optimizer::visitBlockStmt(Block &stmt) {
+  vector<shared_ptr<Stmt>> statements =
+      optimize_block(stmt.statements, level >= 2);
+
+  if (statements != stmt.statements) {
+    stmt_result = make_shared<Block>(Block(statements));
+  }
+}
+
+void Optimizer::visitIfStmt(If &stmt) {
+  shared_ptr<Expr> condition = optimize(stmt.condition);
+  const Literal *constant_condition = constant(condition);
+
+  if (constant_condition != nullptr) {
+    shared_ptr<Stmt> taken = constant_condition->value.is_truthy()
+                                 ? stmt.then_branch
+                                 : stmt.else_branch;
+    shared_ptr<Stmt> result = optimize(taken);
+    stmt_result = result != nullptr ? result : make_shared<Block>(Block({}));
+    return;
+  }
+
+  shared_ptr<Stmt> then_branch = optimize(stmt.then_branch);
+  shared_ptr<Stmt> else_branch = optimize(stmt.else_branch);
+
+  if (else_branch != nullptr && is_empty(else_branch)) {
+    else_branch = nullptr;
+  }
+
+  // Only the condition's side effects and errors are left.
+  if (is_empty(then_branch) && else_branch == nullptr) {
+    stmt_result = make_shared<Expression>(Expression(condition));
+  } else if (condition != stmt.condition || then_branch != stmt.then_branch ||
+             else_branch != stmt.else_branch) {
+    stmt_result = make_shared<If>(If(condition, then_branch, else_branch));
+  }
+}
+
+void Optimizer::visitWhileStmt(While &stmt) {
+  shared_ptr<Expr> condition = optimize(stmt.condition);
+  const Literal *constant_condition = constant(condition);
+
+  if (constant_condition != nullptr && !constant_condition->value.is_truthy()) {
+    stmt_result = make_shared<Block>(Block({}));
+    return;
+  }
+
+  shared_ptr<Stmt> body = optimize(stmt.body);
+
+  if (condition != stmt.condition || body != stmt.body) {
+    stmt_result = make_shared<While>(condition, body);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "literals/value.h"
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include "vm/token.h"
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Optional pass run between Parser::parse() and the Resolver / Compiler.
+//
+// Level 1 folds constant Unary, Binary, Grouping and Logical trees, replaces
+// If and While statements whose condition is constant by the branch that runs
+// and drops empty blocks. Level 2 additionally splices blocks that declare no
+// variables into the enclosing block and drops expression statements that
+// are constants.
+//
+// Expressions that would raise a runtime error, such as "a" - 1, are left in
+// place so the error is still raised at runtime on the same line. The input
+// tree is never modified: changed subtrees are rebuilt and unchanged ones are
+// shared with the result.
+class Optimizer final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  explicit Optimizer(int level) : level(level) {}
+  vector<shared_ptr<Stmt>> optimize(const vector<shared_ptr<Stmt>> &statements);
+
+  void visitBinaryExpr(Binary &expr);
+  void visitGroupingExpr(Grouping &expr);
+  void visitLiteralExpr(Literal &expr);
+  void visitUnaryExpr(Unary &expr);
+  void visitVariableExpr(Variable &expr);
+  void visitAssignExpr(Assign &expr);
+  void visitLogicalExpr(Logical &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  const int level;
+  // Replacement for the node being visited, nullptr to keep it. A statement
+  // that optimizes away entirely is replaced by an empty Block.
+  shared_ptr<Expr> expr_result;
+  shared_ptr<Stmt> stmt_result;
+
+  shared_ptr<Expr> optimize(const shared_ptr<Expr> &expr);
+  shared_ptr<Stmt> optimize(const shared_ptr<Stmt> &stmt);
+  vector<shared_ptr<Stmt>>
+  optimize_block(const vector<shared_ptr<Stmt>> &statements, bool splice);
+  static const Literal *constant(const shared_ptr<Expr> &expr);
+  static bool is_empty(const shared_ptr<Stmt> &stmt);
+  static bool fold_binary(TokenType op, const Value &left, const Value &right,
+                          Value &result);
+};
+
+#endif
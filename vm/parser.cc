@@ -1,17 +1,19 @@
 #include "vm/parser.h"
+#include "vm/scanner.h"
+
+Parser::Parser(Scanner &scanner)
+    : literals(1 + WINDOW), scanner(&scanner),
+      window(WINDOW, Token(TokenType::ENDOF, "", 0, 0)) {}
 
 shared_ptr<Expr> Parser::expression() { return assignment(); }
 
 shared_ptr<Expr> Parser::equality() {
   shared_ptr<Expr> expr = comparison();
 
-  std::vector<TokenType> types = {TokenType::BANG_EQUAL,
-                                  TokenType::EQUAL_EQUAL};
-
-  while (match(types)) {
+  while (match({TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL})) {
     Token op = previous();
     shared_ptr<Expr> right = comparison();
-    expr = make_shared<Binary>(Binary(expr, op, right));
+    expr = make_shared<Binary>(expr, op, right);
   }
 
   return expr;
@@ -20,13 +22,11 @@ shared_ptr<Expr> Parser::equality() {
 shared_ptr<Expr> Parser::comparison() {
   shared_ptr<Expr> expr = term();
 
-  std::vector<TokenType> types = {TokenType::GREATER, TokenType::GREATER_EQUAL,
-                                  TokenType::LESS, TokenType::LESS_EQUAL};
-
-  while (match(types)) {
+  while (match({TokenType::GREATER, TokenType::GREATER_EQUAL, TokenType::LESS,
+                TokenType::LESS_EQUAL})) {
     Token op = previous();
     shared_ptr<Expr> right = term();
-    expr = make_shared<Binary>(Binary(expr, op, right));
+    expr = make_shared<Binary>(expr, op, right);
   }
 
   return expr;
@@ -35,12 +35,10 @@ shared_ptr<Expr> Parser::comparison() {
 shared_ptr<Expr> Parser::term() {
   shared_ptr<Expr> expr = factor();
 
-  std::vector<TokenType> types = {TokenType::MINUS, TokenType::PLUS};
-
-  while (match(types)) {
+  while (match({TokenType::MINUS, TokenType::PLUS})) {
     Token op = previous();
     shared_ptr<Expr> right = factor();
-    expr = make_shared<Binary>(Binary(expr, op, right));
+    expr = make_shared<Binary>(expr, op, right);
   }
 
   return expr;
@@ -49,64 +47,54 @@ shared_ptr<Expr> Parser::term() {
 shared_ptr<Expr> Parser::factor() {
   shared_ptr<Expr> expr = unary();
 
-  std::vector<TokenType> types = {TokenType::SLASH, TokenType::STAR};
-
-  while (match(types)) {
+  while (match({TokenType::SLASH, TokenType::STAR})) {
     Token op = previous();
     shared_ptr<Expr> right = unary();
-    expr = make_shared<Binary>(Binary(expr, op, right));
+    expr = make_shared<Binary>(expr, op, right);
   }
 
   return expr;
 }
 
 shared_ptr<Expr> Parser::unary() {
-  std::vector<TokenType> types = {TokenType::BANG, TokenType::MINUS};
-
-  if (match(types)) {
+  if (match({TokenType::BANG, TokenType::MINUS})) {
     Token op = previous();
     shared_ptr<Expr> right = unary();
-    return make_shared<Unary>(Unary(op, right));
+    return make_shared<Unary>(op, right);
   }
 
   return primary();
 }
 
 shared_ptr<Expr> Parser::primary() {
-  std::vector<TokenType> types = {TokenType::FALSE};
-
-  if (match(types))
-    return make_shared<Literal>(Literal(make_shared<Boolean>(Boolean(false))));
+  if (match({TokenType::FALSE}))
+    return make_shared<Literal>(Literal(Value(false)));
 
-  types = {TokenType::TRUE};
-  if (match(types))
-    return make_shared<Literal>(make_shared<Boolean>(Boolean(true)));
+  if (match({TokenType::TRUE}))
+    return make_shared<Literal>(Literal(Value(true)));
 
-  types = {TokenType::NIL};
-  if (match(types))
-    return make_shared<Literal>(Literal(nullptr));
+  if (match({TokenType::NIL}))
+    return make_shared<Literal>(Literal(Value()));
 
-  types = {TokenType::NUMBER, TokenType::STRING};
-  if (match(types)) {
-    return make_shared<Literal>(Literal(previous().literal));
+  if (match({TokenType::NUMBER, TokenType::STRING})) {
+    return make_shared<Literal>(Literal(literals[previous().literal]));
   }
 
-  types = {TokenType::IDENTIFIER};
-  if (match(types)) {
+  if (match({TokenType::IDENTIFIER})) {
     return make_shared<Variable>(Variable(previous()));
   }
 
-  types = {TokenType::LEFT_PAREN};
-  if (match(types)) {
+  if (match({TokenType::LEFT_PAREN})) {
     shared_ptr<Expr> expr = expression();
     consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
     return make_shared<Grouping>(Grouping(expr));
   }
 
-  throw ParseError(peek(), "Expect expression.");
+  error(peek(), "Expect expression.");
+  return nullptr;
 }
 
-bool Parser::match(std::vector<TokenType> types) {
+bool Parser::match(std::initializer_list<TokenType> types) {
   for (TokenType type : types) {
     if (check(type)) {
       advance();
@@ -118,14 +106,14 @@ bool Parser::match(std::vector<TokenType> types) {
 }
 
 bool Parser::check(TokenType type) {
-  if (is_at_end()) {
+  if (panic || is_at_end()) {
     return false;
   }
 
   return peek().type == type;
 }
 
-Token Parser::advance() {
+const Token &Parser::advance() {
   if (!is_at_end()) {
     current++;
   }
@@ -133,13 +121,21 @@ Token Parser::advance() {
   return previous();
 }
 
-Token Parser::consume(TokenType type, string message) {
+const Token &Parser::consume(TokenType type, const string &message) {
   if (check(type))
     return advance();
 
-  Token token = peek();
+  const Token &token = peek();
+  error(token, message);
+  return token;
+}
+
+void Parser::error(const Token &token, const string &message) {
+  if (panic)
+    return;
+
   Vm::error(token, message);
-  throw ParseError(token, message);
+  panic = true;
 }
 
 void Parser::synchronize() {
@@ -177,25 +173,33 @@ vector<shared_ptr<Stmt>> Parser::parse() {
   return statements;
 }
 
+shared_ptr<Stmt> Parser::parse_declaration() { return declaration(); }
+
 shared_ptr<Stmt> Parser::statement() {
-  vector<TokenType> types = {TokenType::FOR};
-  if (match(types))
+  uint32_t line = peek().line;
+  shared_ptr<Stmt> stmt = simple_statement();
+
+  if (stmt != nullptr) {
+    stmt->line = line;
+  }
+
+  return stmt;
+}
+
+shared_ptr<Stmt> Parser::simple_statement() {
+  if (match({TokenType::FOR}))
     return for_statement();
 
-  types = {TokenType::IF};
-  if (match(types))
+  if (match({TokenType::IF}))
     return if_statement();
 
-  types = {TokenType::PRINT};
-  if (match(types))
+  if (match({TokenType::PRINT}))
     return print_statement();
 
-  types = {TokenType::WHILE};
-  if (match(types))
+  if (match({TokenType::WHILE}))
     return while_statement();
 
-  types = {TokenType::LEFT_BRACE};
-  if (match(types))
+  if (match({TokenType::LEFT_BRACE}))
     return make_shared<Block>(Block(block()));
 
   return expression_statement();
@@ -215,41 +219,66 @@ shared_ptr<Stmt> Parser::expression_statement() {
 
 bool Parser::is_at_end() { return peek().type == TokenType::ENDOF; }
 
-Token Parser::peek() { return tokens[current]; }
+const Token &Parser::token(size_t index) {
+  if (scanner == nullptr)
+    return tokens[index];
+
+  while (pulled <= index) {
+    size_t slot = pulled % WINDOW;
+    Token &token = window[slot] = scanner->next();
+
+    if (token.literal != 0) {
+      literals[1 + slot] = scanner->literals()[token.literal];
+      token.literal = static_cast<uint32_t>(1 + slot);
+    }
+
+    pulled++;
+  }
+
+  return window[index % WINDOW];
+}
+
+const Token &Parser::peek() { return token(current); }
 
-Token Parser::previous() { return tokens[current - 1]; }
+const Token &Parser::previous() { return token(current - 1); }
 
 shared_ptr<Stmt> Parser::declaration() {
-  try {
-    vector<TokenType> types = {TokenType::VAR};
-    if (match(types))
-      return var_declaration();
+  shared_ptr<Stmt> stmt;
 
-    return statement();
-  } catch (ParseError error) {
+  if (match({TokenType::VAR})) {
+    stmt = var_declaration();
+  } else {
+    stmt = statement();
+  }
+
+  if (panic) {
+    panic = false;
     synchronize();
     return nullptr;
   }
+
+  return stmt;
 }
 
 shared_ptr<Stmt> Parser::var_declaration() {
+  uint32_t line = previous().line;
   Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
 
   shared_ptr<Expr> initializer = nullptr;
-  vector<TokenType> types = {TokenType::EQUAL};
-  if (match(types)) {
+  if (match({TokenType::EQUAL})) {
     initializer = expression();
   }
 
   consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
-  return make_shared<Var>(Var(name, initializer));
+  shared_ptr<Stmt> stmt = make_shared<Var>(Var(name, initializer));
+  stmt->line = line;
+  return stmt;
 }
 
 shared_ptr<Expr> Parser::assignment() {
   shared_ptr<Expr> expr = logical_or();
 
-  vector<TokenType> types = {TokenType::EQUAL};
-  if (match(types)) {
+  if (match({TokenType::EQUAL})) {
     Token equals = previous();
     shared_ptr<Expr> value = assignment();
 
@@ -267,7 +296,7 @@ shared_ptr<Expr> Parser::assignment() {
 vector<shared_ptr<Stmt>> Parser::block() {
   vector<shared_ptr<Stmt>> statements;
 
-  while (!check(TokenType::RIGHT_BRACE) && !is_at_end()) {
+  while (!panic && !check(TokenType::RIGHT_BRACE) && !is_at_end()) {
     statements.push_back(declaration());
   }
 
@@ -283,8 +312,7 @@ shared_ptr<Stmt> Parser::if_statement() {
   shared_ptr<Stmt> then_branch = statement();
   shared_ptr<Stmt> else_branch = nullptr;
 
-  vector<TokenType> types = {TokenType::ELSE};
-  if (match(types)) {
+  if (match({TokenType::ELSE})) {
     else_branch = statement();
   }
 
@@ -294,8 +322,7 @@ shared_ptr<Stmt> Parser::if_statement() {
 shared_ptr<Expr> Parser::logical_or() {
   shared_ptr<Expr> expr = logical_and();
 
-  vector<TokenType> types = {TokenType::OR};
-  while (match(types)) {
+  while (match({TokenType::OR})) {
     Token op = previous();
     shared_ptr<Expr> right = logical_and();
     expr = make_shared<Logical>(Logical(expr, op, right));
@@ -307,8 +334,7 @@ shared_ptr<Expr> Parser::logical_or() {
 shared_ptr<Expr> Parser::logical_and() {
   shared_ptr<Expr> expr = equality();
 
-  vector<TokenType> types = {TokenType::AND};
-  while (match(types)) {
+  while (match({TokenType::AND})) {
     Token op = previous();
     shared_ptr<Expr> right = equality();
     expr = make_shared<Logical>(Logical(expr, op, right));
@@ -323,22 +349,22 @@ shared_ptr<Stmt> Parser::while_statement() {
   consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
   shared_ptr<Stmt> body = statement();
 
-  return make_shared<While>(While(condition, body));
+  return make_shared<While>(condition, body);
 }
 
 shared_ptr<Stmt> Parser::for_statement() {
+  uint32_t line = previous().line;
   consume(TokenType::LEFT_PAREN, "Expect '(' after 'for'.");
 
   shared_ptr<Stmt> initializer;
-  vector<TokenType> types = {TokenType::SEMICOLON};
-  vector<TokenType> var = {TokenType::VAR};
 
-  if (match(types)) {
+  if (match({TokenType::SEMICOLON})) {
     initializer = nullptr;
-  } else if (match(var)) {
+  } else if (match({TokenType::VAR})) {
     initializer = var_declaration();
   } else {
     initializer = expression_statement();
+    initializer->line = line;
   }
 
   shared_ptr<Expr> condition = nullptr;
@@ -357,17 +383,21 @@ shared_ptr<Stmt> Parser::for_statement() {
 
   shared_ptr<Stmt> body = statement();
 
+  // The statements the loop desugars to all belong to the "for" line.
   if (increment != nullptr) {
-    vector<shared_ptr<Stmt>> statements = {body,
-                                           make_shared<Expression>(increment)};
+    shared_ptr<Stmt> step = make_shared<Expression>(increment);
+    step->line = line;
+    vector<shared_ptr<Stmt>> statements = {body, step};
     body = make_shared<Block>(Block(statements));
+    body->line = line;
   }
 
   if (condition == nullptr) {
-    condition = make_shared<Literal>(Literal(make_shared<Boolean>(true)));
+    condition = make_shared<Literal>(Literal(Value(true)));
   }
 
-  body = make_shared<While>(While(condition, body));
+  body = make_shared<While>(condition, body);
+  body->line = line;
 
   if (initializer != nullptr) {
     vector<shared_ptr<Stmt>> statements = {initializer, body};
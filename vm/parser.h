@@ -1,26 +1,50 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include "literals/boolean.h"
+#include "literals/value.h"
 #include "vm/expr.h"
 #include "vm/stmt.h"
 #include "vm/token.h"
 #include "vm/vm.h"
-#include <exception>
+#include <initializer_list>
 #include <memory>
 #include <string>
 #include <vector>
 
 using namespace std;
 
+class Scanner;
+
 class Parser final {
 public:
-  Parser(std::vector<Token> tokens) : tokens(tokens) {}
+  Parser(std::vector<Token> tokens, std::vector<Value> literals)
+      : tokens(std::move(tokens)), literals(std::move(literals)) {}
+  // Streaming parser pulling tokens from the scanner on demand. Only a small
+  // window of tokens around the current one is kept alive.
+  explicit Parser(Scanner &scanner);
   vector<shared_ptr<Stmt>> parse();
+  // Parses a single top level declaration. Returns nullptr after a syntax
+  // error, once the parser has synchronized past it.
+  shared_ptr<Stmt> parse_declaration();
+  bool is_at_end();
 
 private:
+  // Must be a power of two and hold at least previous() and peek().
+  static constexpr size_t WINDOW = 4;
+
   const std::vector<Token> tokens;
-  int current = 0;
+  // When streaming, token i lives in window[i % WINDOW] and its literal in
+  // literals[1 + i % WINDOW]; index 0 stays the "no literal" entry.
+  std::vector<Value> literals;
+  Scanner *scanner = nullptr;
+  std::vector<Token> window;
+  size_t pulled = 0;
+  size_t current = 0;
+  // Set when a syntax error has been reported. Until the enclosing
+  // declaration() synchronizes, check() matches nothing and consume() reports
+  // nothing, so every production unwinds through plain returns and the
+  // partial tree is discarded.
+  bool panic = false;
 
   shared_ptr<Expr> expression();
   shared_ptr<Expr> equality();
@@ -32,15 +56,17 @@ private:
   shared_ptr<Expr> assignment();
   shared_ptr<Expr> logical_or();
   shared_ptr<Expr> logical_and();
-  bool match(std::vector<TokenType> types);
+  bool match(std::initializer_list<TokenType> types);
   bool check(TokenType type);
-  Token advance();
-  Token consume(TokenType type, string message);
-  bool is_at_end();
-  Token peek();
-  Token previous();
+  const Token &advance();
+  const Token &consume(TokenType type, const string &message);
+  void error(const Token &token, const string &message);
+  const Token &token(size_t index);
+  const Token &peek();
+  const Token &previous();
   void synchronize();
   shared_ptr<Stmt> statement();
+  shared_ptr<Stmt> simple_statement();
   shared_ptr<Stmt> print_statement();
   shared_ptr<Stmt> expression_statement();
   shared_ptr<Stmt> declaration();
@@ -51,14 +77,4 @@ private:
   vector<shared_ptr<Stmt>> block();
 };
 
-class ParseError : public exception {
-public:
-  ParseError(Token token, const string &message)
-      : token(token), message(message) {}
-
-private:
-  Token token;
-  string message;
-};
-
 #endif
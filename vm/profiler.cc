@@ -0,0 +1,162 @@
+#include "vm/profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sys/time.h>
+#include <vector>
+
+volatile sig_atomic_t Profiler::depth = 0;
+volatile uint32_t Profiler::frames[MAX_DEPTH];
+volatile uint32_t Profiler::leaf = 0;
+Profiler::Stack Profiler::stacks[STACKS];
+size_t Profiler::samples = 0;
+size_t Profiler::dropped = 0;
+int Profiler::hz = 0;
+
+static const char *const KIND_NAMES[] = {"expression", "print", "var",
+                                         "block",      "if",    "while"};
+
+bool Profiler::start(int hz) {
+  struct sigaction action = {};
+  action.sa_handler = sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    return false;
+  }
+
+  Profiler::hz = hz;
+  itimerval timer = {};
+  timer.it_interval.tv_usec = 1000000 / hz;
+  timer.it_value = timer.it_interval;
+  return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+void Profiler::stop() {
+  itimerval timer = {};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  signal(SIGPROF, SIG_IGN);
+}
+
+// Runs in the signal handler: no allocation, no locks, no library calls.
+void Profiler::sample(int signal) {
+  int current = depth;
+  uint32_t count = static_cast<uint32_t>(min(current, MAX_DEPTH));
+  uint32_t sampled[MAX_DEPTH];
+
+  for (uint32_t i = 0; i < count; i++) {
+    sampled[i] = frames[i];
+  }
+
+  if (leaf != 0 && count < MAX_DEPTH) {
+    sampled[count++] = leaf;
+  }
+
+  uint32_t hash = 2166136261u;
+
+  for (uint32_t i = 0; i < count; i++) {
+    hash = (hash ^ sampled[i]) * 16777619u;
+  }
+
+  samples++;
+
+  for (size_t probe = 0; probe < STACKS; probe++) {
+    Stack &stack = stacks[(hash + probe) % STACKS];
+
+    if (stack.samples == 0) {
+      stack.depth = count;
+
+      for (uint32_t i = 0; i < count; i++) {
+        stack.frames[i] = sampled[i];
+      }
+
+      stack.samples = 1;
+      return;
+    }
+
+    if (stack.depth == count &&
+        equal(stack.frames, stack.frames + count, sampled)) {
+      stack.samples++;
+      return;
+    }
+  }
+
+  dropped++;
+}
+
+string Profiler::label(uint32_t frame) {
+  return string(KIND_NAMES[frame & 7]) + " (line " + to_string(frame >> 3) +
+         ")";
+}
+
+// Samples taken outside any statement, while scanning and parsing, are
+// attributed to the root alone.
+void Profiler::write_folded(ostream &out, const string &root) {
+  for (const Stack &stack : stacks) {
+    if (stack.samples == 0) {
+      continue;
+    }
+
+    out << root;
+
+    for (uint32_t i = 0; i < stack.depth; i++) {
+      out << ";" << label(stack.frames[i]);
+    }
+
+    out << " " << stack.samples << "\n";
+  }
+}
+
+// Self samples are those whose innermost statement is on the line, total
+// samples those with the line anywhere on the stack.
+void Profiler::report(ostream &out, size_t top) {
+  map<uint32_t, pair<size_t, size_t>> lines;
+  map<uint32_t, uint32_t> kinds;
+
+  for (const Stack &stack : stacks) {
+    if (stack.samples == 0 || stack.depth == 0) {
+      continue;
+    }
+
+    vector<uint32_t> seen;
+
+    for (uint32_t i = 0; i < stack.depth; i++) {
+      uint32_t line = stack.frames[i] >> 3;
+
+      if (find(seen.begin(), seen.end(), line) == seen.end()) {
+        seen.push_back(line);
+        lines[line].second += stack.samples;
+      }
+    }
+
+    uint32_t innermost = stack.frames[stack.depth - 1];
+    lines[innermost >> 3].first += stack.samples;
+    kinds[innermost >> 3] = innermost & 7;
+  }
+
+  vector<pair<uint32_t, pair<size_t, size_t>>> hottest(lines.begin(),
+                                                       lines.end());
+  sort(hottest.begin(), hottest.end(), [](const auto &a, const auto &b) {
+    return a.second.first != b.second.first ? a.second.first > b.second.first
+                                            : a.first < b.first;
+  });
+
+  double total = samples > 0 ? static_cast<double>(samples) : 1;
+  out << fixed << setprecision(1);
+  out << "[profile] " << samples << " samples at " << hz << " Hz, "
+      << dropped << " dropped" << endl;
+  out << "[profile]   self%  total%   line  statement" << endl;
+
+  for (size_t i = 0; i < hottest.size() && i < top; i++) {
+    uint32_t line = hottest[i].first;
+
+    if (hottest[i].second.first == 0) {
+      break;
+    }
+
+    out << "[profile] " << setw(7) << 100 * hottest[i].second.first / total
+        << " " << setw(7) << 100 * hottest[i].second.second / total << " "
+        << setw(6) << line << "  " << KIND_NAMES[kinds[line]] << endl;
+  }
+}
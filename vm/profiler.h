@@ -0,0 +1,84 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+// Sampling profiler behind --profile.
+//
+// The ProfilingInterpreter keeps a shadow stack of the blocks, ifs and whiles
+// being executed, innermost last, through Frame guards. Simple statements,
+// the ones run most often, are not pushed: each only records itself as the
+// statement running below the innermost frame, until the next one does or
+// that frame ends.
+//
+// SIGPROF fires every 1/hz seconds of CPU time and the handler adds the
+// current stack to a fixed size table of distinct stacks, so sampling never
+// allocates and memory stays bounded however long the script runs. Stacks
+// that no longer fit are counted as dropped. Afterwards the table is written
+// out as collapsed stacks, one "frame;frame;... count" line per stack as
+// flamegraph.pl and similar tools read them, and summarized as a table of the
+// hottest lines.
+class Profiler final {
+public:
+  enum class Kind : uint8_t { EXPRESSION, PRINT, VAR, BLOCK, IF, WHILE };
+
+  // Pushes a compound statement for as long as it runs, exceptions included.
+  class Frame final {
+  public:
+    Frame(uint32_t line, Kind kind) {
+      int top = depth;
+      leaf = 0;
+      if (top < MAX_DEPTH)
+        frames[top] = frame(line, kind);
+      depth = top + 1;
+    }
+
+    ~Frame() {
+      leaf = 0;
+      depth = depth - 1;
+    }
+  };
+
+  // Records a simple statement as the one running.
+  static void enter(uint32_t line, Kind kind) { leaf = frame(line, kind); }
+
+  static bool start(int hz);
+  static void stop();
+  static void write_folded(ostream &out, const string &root);
+  static void report(ostream &out, size_t top);
+
+private:
+  // Frames kept per stack, the simple statement included.
+  static constexpr int MAX_DEPTH = 64;
+  static constexpr size_t STACKS = 4096;
+
+  struct Stack {
+    uint32_t samples;
+    uint32_t depth;
+    uint32_t frames[MAX_DEPTH];
+  };
+
+  static volatile sig_atomic_t depth;
+  static volatile uint32_t frames[MAX_DEPTH];
+  // The simple statement running below the innermost frame, or 0.
+  static volatile uint32_t leaf;
+  static Stack stacks[STACKS];
+  static size_t samples;
+  static size_t dropped;
+  static int hz;
+
+  static uint32_t frame(uint32_t line, Kind kind) {
+    return line << 3 | static_cast<uint32_t>(kind);
+  }
+
+  static void sample(int signal);
+  static string label(uint32_t frame);
+};
+
+#endif
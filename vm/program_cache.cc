@@ -0,0 +1,629 @@
+#include "vm/program_cache.h"
+#include "vm/source.h"
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+enum class Kind : uint8_t {
+  BINARY,
+  GROUPING,
+  LITERAL,
+  UNARY,
+  VARIABLE,
+  ASSIGN,
+  LOGICAL,
+  EXPRESSION,
+  PRINT,
+  VAR,
+  BLOCK,
+  IF,
+  WHILE
+};
+
+enum class Tag : uint8_t { NIL, FALSE, TRUE, NUMBER, STRING };
+
+constexpr uint32_t NONE = UINT32_MAX;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t hash;
+  uint64_t length;
+  uint32_t optimization;
+  uint32_t records;
+  uint32_t children;
+  uint32_t strings;
+  // The top level statements, as a range of the child lists.
+  uint32_t first_root;
+  uint32_t roots;
+  // Hash of everything after the header, which the Reader's checks alone
+  // would not catch all damage to: a flipped literal or operator still
+  // makes a valid tree, of another program.
+  uint64_t checksum;
+};
+
+// One node. children holds record indexes, NONE for absent ones, except for
+// a Block, whose children are children[1] entries of the child lists from
+// children[0] on, and a Literal, whose children hold the bits of its number
+// or the offset and length of its string.
+struct Record {
+  Kind kind;
+  // TokenType of the node's token, or the Tag of a Literal.
+  uint8_t type;
+  uint16_t unused;
+  // Line of a statement.
+  uint32_t line;
+  // Line and lexeme of the node's token.
+  uint32_t token_line;
+  uint32_t start;
+  uint32_t length;
+  uint32_t children[3];
+};
+
+constexpr char MAGIC[4] = {'L', 'O', 'X', 'C'};
+
+// Appends the nodes of a tree in post-order.
+class Writer final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  explicit Writer(string_view source) : source(source) {}
+
+  vector<Record> records;
+  vector<uint32_t> children;
+  string strings;
+  // Set when a node cannot be represented, like a token outside the source.
+  bool failed = false;
+
+  uint32_t write(const shared_ptr<Expr> &expr) {
+    if (expr == nullptr) {
+      return NONE;
+    }
+
+    expr->accept(this);
+    return static_cast<uint32_t>(records.size() - 1);
+  }
+
+  uint32_t write(const shared_ptr<Stmt> &stmt) {
+    if (stmt == nullptr) {
+      return NONE;
+    }
+
+    stmt->accept(this);
+    records.back().line = stmt->line;
+    return static_cast<uint32_t>(records.size() - 1);
+  }
+
+  // Writes statements, then their indexes as one child list. Returns the
+  // list's first entry.
+  uint32_t write_list(const vector<shared_ptr<Stmt>> &statements) {
+    vector<uint32_t> indexes;
+
+    for (const shared_ptr<Stmt> &statement : statements) {
+      indexes.push_back(write(statement));
+    }
+
+    uint32_t first = static_cast<uint32_t>(children.size());
+    children.insert(children.end(), indexes.begin(), indexes.end());
+    return first;
+  }
+
+  void visitBinaryExpr(Binary &expr) {
+    uint32_t left = write(expr.left);
+    uint32_t right = write(expr.right);
+    add(Kind::BINARY, &expr.op, left, right);
+  }
+
+  void visitGroupingExpr(Grouping &expr) {
+    add(Kind::GROUPING, nullptr, write(expr.expression));
+  }
+
+  void visitLiteralExpr(Literal &expr) {
+    Record record = make(Kind::LITERAL, nullptr);
+    const Value &value = expr.value;
+
+    if (value.is_nil()) {
+      record.type = static_cast<uint8_t>(Tag::NIL);
+    } else if (value.is_bool()) {
+      record.type = static_cast<uint8_t>(value.as_bool() ? Tag::TRUE
+                                                         : Tag::FALSE);
+    } else if (value.is_number()) {
+      record.type = static_cast<uint8_t>(Tag::NUMBER);
+      double number = value.as_number();
+      memcpy(record.children, &number, sizeof(number));
+    } else {
+      string_view text = value.as_string()->view();
+      record.type = static_cast<uint8_t>(Tag::STRING);
+      record.children[0] = static_cast<uint32_t>(strings.size());
+      record.children[1] = static_cast<uint32_t>(text.size());
+      strings.append(text);
+    }
+
+    records.push_back(record);
+  }
+
+  void visitUnaryExpr(Unary &expr) {
+    add(Kind::UNARY, &expr.op, write(expr.right));
+  }
+
+  void visitVariableExpr(Variable &expr) { add(Kind::VARIABLE, &expr.name); }
+
+  void visitAssignExpr(Assign &expr) {
+    add(Kind::ASSIGN, &expr.name, write(expr.value));
+  }
+
+  void visitLogicalExpr(Logical &expr) {
+    uint32_t left = write(expr.left);
+    uint32_t right = write(expr.right);
+    add(Kind::LOGICAL, &expr.op, left, right);
+  }
+
+  void visitExpressionStmt(Expression &stmt) {
+    add(Kind::EXPRESSION, nullptr, write(stmt.expr));
+  }
+
+  void visitPrintStmt(Print &stmt) {
+    add(Kind::PRINT, nullptr, write(stmt.expr));
+  }
+
+  void visitVarStmt(Var &stmt) {
+    add(Kind::VAR, &stmt.name, write(stmt.initializer));
+  }
+
+  void visitBlockStmt(Block &stmt) {
+    uint32_t first = write_list(stmt.statements);
+    add(Kind::BLOCK, nullptr, first,
+        static_cast<uint32_t>(stmt.statements.size()));
+  }
+
+  void visitIfStmt(If &stmt) {
+    uint32_t condition = write(stmt.condition);
+    uint32_t then_branch = write(stmt.then_branch);
+    uint32_t else_branch = write(stmt.else_branch);
+    add(Kind::IF, nullptr, condition, then_branch, else_branch);
+  }
+
+  void visitWhileStmt(While &stmt) {
+    uint32_t condition = write(stmt.condition);
+    uint32_t body = write(stmt.body);
+    add(Kind::WHILE, nullptr, condition, body);
+  }
+
+private:
+  string_view source;
+
+  Record make(Kind kind, const Token *token) {
+    Record record = {};
+    record.kind = kind;
+
+    if (token != nullptr) {
+      if (token->start < source.data() ||
+          token->start + token->length > source.data() + source.size()) {
+        failed = true;
+      }
+
+      record.type = static_cast<uint8_t>(token->type);
+      record.token_line = token->line;
+      record.start = static_cast<uint32_t>(token->start - source.data());
+      record.length = token->length;
+    }
+
+    return record;
+  }
+
+  void add(Kind kind, const Token *token, uint32_t first = NONE,
+           uint32_t second = NONE, uint32_t third = NONE) {
+    Record record = make(kind, token);
+    record.children[0] = first;
+    record.children[1] = second;
+    record.children[2] = third;
+    records.push_back(record);
+  }
+};
+
+// Owns every node of a loaded program, carved out of a few large blocks
+// instead of one allocation each. Nodes point at their children through
+// non-owning shared_ptrs, so building and walking the tree touches no
+// reference counts; only the program's top level statements share ownership
+// of the arena, which frees every node once the last of them is gone.
+class Arena final {
+public:
+  explicit Arena(size_t nodes) { this->nodes.reserve(nodes); }
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    for (auto node = nodes.rbegin(); node != nodes.rend(); node++) {
+      node->second(node->first);
+    }
+  }
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    constexpr size_t size =
+        (sizeof(T) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+    if (blocks.empty() || used + size > BLOCK) {
+      blocks.push_back(make_unique<max_align_t[]>(BLOCK / sizeof(max_align_t)));
+      used = 0;
+    }
+
+    char *memory = reinterpret_cast<char *>(blocks.back().get()) + used;
+    T *node = new (memory) T(forward<Args>(args)...);
+    used += size;
+    nodes.push_back({node, [](void *node) { static_cast<T *>(node)->~T(); }});
+    return node;
+  }
+
+private:
+  static constexpr size_t BLOCK = 64 * 1024;
+
+  vector<unique_ptr<max_align_t[]>> blocks;
+  size_t used = 0;
+  vector<pair<void *, void (*)(void *)>> nodes;
+};
+
+// Rebuilds the nodes of a mapped cache file, checking every index on the
+// way so a damaged file is rejected rather than trusted.
+class Reader final {
+public:
+  Reader(const Header &header, const Record *records, const uint32_t *children,
+         const char *strings, string_view source)
+      : header(header), records(records), children(children),
+        strings(strings), source(source),
+        arena(make_shared<Arena>(header.records)), exprs(header.records),
+        stmts(header.records) {}
+
+  bool read(vector<shared_ptr<Stmt>> &statements) {
+    for (uint32_t i = 0; i < header.records; i++) {
+      if (!read(i)) {
+        return false;
+      }
+    }
+
+    if (!list(header.first_root, header.roots, header.records, statements)) {
+      return false;
+    }
+
+    // A node no parent took means the header's roots are off.
+    for (uint32_t i = 0; i < header.records; i++) {
+      if (exprs[i] != nullptr || stmts[i] != nullptr) {
+        return false;
+      }
+    }
+
+    for (shared_ptr<Stmt> &statement : statements) {
+      statement = shared_ptr<Stmt>(arena, statement.get());
+    }
+
+    return true;
+  }
+
+private:
+  const Header &header;
+  const Record *records;
+  const uint32_t *children;
+  const char *strings;
+  string_view source;
+  shared_ptr<Arena> arena;
+  // Nodes not yet taken by their parent.
+  vector<Expr *> exprs;
+  vector<Stmt *> stmts;
+
+  // Takes the expression at child, which must come before the record at
+  // index and have no other parent.
+  bool expr(uint32_t child, uint32_t index, bool optional,
+            shared_ptr<Expr> &out) {
+    if (child == NONE) {
+      return optional;
+    }
+
+    if (child >= index || exprs[child] == nullptr) {
+      return false;
+    }
+
+    out = shared_ptr<Expr>(shared_ptr<Expr>(), exprs[child]);
+    exprs[child] = nullptr;
+    return true;
+  }
+
+  bool stmt(uint32_t child, uint32_t index, bool optional,
+            shared_ptr<Stmt> &out) {
+    if (child == NONE) {
+      return optional;
+    }
+
+    if (child >= index || stmts[child] == nullptr) {
+      return false;
+    }
+
+    out = shared_ptr<Stmt>(shared_ptr<Stmt>(), stmts[child]);
+    stmts[child] = nullptr;
+    return true;
+  }
+
+  bool list(uint32_t first, uint32_t count, uint32_t index,
+            vector<shared_ptr<Stmt>> &out) {
+    if (first > header.children || count > header.children - first) {
+      return false;
+    }
+
+    out.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+      shared_ptr<Stmt> statement;
+
+      if (!stmt(children[first + i], index, false, statement)) {
+        return false;
+      }
+
+      out.push_back(move(statement));
+    }
+
+    return true;
+  }
+
+  bool token(const Record &record, Token &out) {
+    if (record.start > source.size() ||
+        record.length > source.size() - record.start ||
+        record.type > static_cast<uint8_t>(TokenType::ENDOF)) {
+      return false;
+    }
+
+    out = Token(static_cast<TokenType>(record.type),
+                source.substr(record.start, record.length), 0,
+                record.token_line);
+    return true;
+  }
+
+  bool literal(const Record &record, Value &out) {
+    switch (static_cast<Tag>(record.type)) {
+    case Tag::NIL:
+      out = Value();
+      return true;
+    case Tag::FALSE:
+      out = Value(false);
+      return true;
+    case Tag::TRUE:
+      out = Value(true);
+      return true;
+    case Tag::NUMBER: {
+      double number;
+      memcpy(&number, record.children, sizeof(number));
+      out = Value(number);
+      return true;
+    }
+    case Tag::STRING:
+      if (record.children[0] > header.strings ||
+          record.children[1] > header.strings - record.children[0]) {
+        return false;
+      }
+
+      out = Value(StringTable::intern(
+          string_view(strings + record.children[0], record.children[1])));
+      return true;
+    }
+
+    return false;
+  }
+
+  bool read(uint32_t i) {
+    const Record &record = records[i];
+    const uint32_t *child = record.children;
+    Token name = Token(TokenType::ENDOF, "", 0, 0);
+    shared_ptr<Expr> a, b;
+    shared_ptr<Stmt> s, t;
+
+    switch (record.kind) {
+    case Kind::BINARY:
+      if (!token(record, name) || !expr(child[0], i, false, a) ||
+          !expr(child[1], i, false, b))
+        return false;
+      exprs[i] = arena->make<Binary>(move(a), name, move(b));
+      return true;
+    case Kind::GROUPING:
+      if (!expr(child[0], i, false, a))
+        return false;
+      exprs[i] = arena->make<Grouping>(move(a));
+      return true;
+    case Kind::LITERAL: {
+      Value value;
+
+      if (!literal(record, value))
+        return false;
+      exprs[i] = arena->make<Literal>(value);
+      return true;
+    }
+    case Kind::UNARY:
+      if (!token(record, name) || !expr(child[0], i, false, a))
+        return false;
+      exprs[i] = arena->make<Unary>(name, move(a));
+      return true;
+    case Kind::VARIABLE:
+      if (!token(record, name))
+        return false;
+      exprs[i] = arena->make<Variable>(name);
+      return true;
+    case Kind::ASSIGN:
+      if (!token(record, name) || !expr(child[0], i, false, a))
+        return false;
+      exprs[i] = arena->make<Assign>(name, move(a));
+      return true;
+    case Kind::LOGICAL:
+      if (!token(record, name) || !expr(child[0], i, false, a) ||
+          !expr(child[1], i, false, b))
+        return false;
+      exprs[i] = arena->make<Logical>(move(a), name, move(b));
+      return true;
+    case Kind::EXPRESSION:
+      if (!expr(child[0], i, false, a))
+        return false;
+      stmts[i] = arena->make<Expression>(move(a));
+      break;
+    case Kind::PRINT:
+      if (!expr(child[0], i, false, a))
+        return false;
+      stmts[i] = arena->make<Print>(move(a));
+      break;
+    case Kind::VAR:
+      if (!token(record, name) || !expr(child[0], i, true, a))
+        return false;
+      stmts[i] = arena->make<Var>(name, move(a));
+      break;
+    case Kind::BLOCK: {
+      vector<shared_ptr<Stmt>> statements;
+
+      if (!list(child[0], child[1], i, statements))
+        return false;
+      stmts[i] = arena->make<Block>(move(statements));
+      break;
+    }
+    case Kind::IF:
+      if (!expr(child[0], i, false, a) || !stmt(child[1], i, false, s) ||
+          !stmt(child[2], i, true, t))
+        return false;
+      stmts[i] = arena->make<If>(move(a), move(s), move(t));
+      break;
+    case Kind::WHILE:
+      if (!expr(child[0], i, false, a) || !stmt(child[1], i, false, s))
+        return false;
+      stmts[i] = arena->make<While>(move(a), move(s));
+      break;
+    default:
+      return false;
+    }
+
+    stmts[i]->line = record.line;
+    return true;
+  }
+};
+
+} // namespace
+
+uint64_t ProgramCache::hash(string_view source) {
+  // 64-bit FNV-1a.
+  uint64_t hash = 14695981039346656037ull;
+
+  for (char c : source) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+
+  return hash;
+}
+
+string ProgramCache::path_for(const string &script, const string &directory,
+                              string_view source) {
+  // foo.lox caches to foo.loxc.
+  if (directory.empty()) {
+    bool lox = script.size() > 4 &&
+               script.compare(script.size() - 4, 4, ".lox") == 0;
+    return script + (lox ? "c" : ".loxc");
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.loxc",
+           static_cast<unsigned long long>(hash(source)));
+  return directory + "/" + name;
+}
+
+bool ProgramCache::load(const string &path, string_view source,
+                        int optimization,
+                        vector<shared_ptr<Stmt>> &statements) {
+  unique_ptr<Source> file = Source::open(path);
+
+  if (file == nullptr || file->view().size() < sizeof(Header)) {
+    return false;
+  }
+
+  string_view data = file->view();
+  Header header;
+  memcpy(&header, data.data(), sizeof(header));
+
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION || header.length != source.size() ||
+      header.optimization != static_cast<uint32_t>(optimization)) {
+    return false;
+  }
+
+  size_t size = sizeof(Header) + size_t{header.records} * sizeof(Record) +
+                size_t{header.children} * sizeof(uint32_t) + header.strings;
+
+  if (data.size() != size || header.hash != hash(source) ||
+      header.checksum != hash(data.substr(sizeof(Header)))) {
+    return false;
+  }
+
+  // Mapped files are page aligned and every section's size is a multiple of
+  // four, so the records and child lists are suitably aligned in place.
+  const char *records = data.data() + sizeof(Header);
+  const char *children = records + size_t{header.records} * sizeof(Record);
+  const char *strings =
+      children + size_t{header.children} * sizeof(uint32_t);
+
+  vector<shared_ptr<Stmt>> program;
+  Reader reader(header, reinterpret_cast<const Record *>(records),
+                reinterpret_cast<const uint32_t *>(children), strings, source);
+
+  if (!reader.read(program)) {
+    return false;
+  }
+
+  statements = move(program);
+  return true;
+}
+
+bool ProgramCache::save(const string &path, string_view source,
+                        int optimization,
+                        const vector<shared_ptr<Stmt>> &statements) {
+  if (source.size() >= NONE) {
+    return false;
+  }
+
+  Writer writer(source);
+  uint32_t first_root = writer.write_list(statements);
+
+  if (writer.failed || writer.records.size() >= NONE ||
+      writer.strings.size() >= NONE) {
+    return false;
+  }
+
+  Header header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.hash = hash(source);
+  header.length = source.size();
+  header.optimization = static_cast<uint32_t>(optimization);
+  header.records = static_cast<uint32_t>(writer.records.size());
+  header.children = static_cast<uint32_t>(writer.children.size());
+  header.strings = static_cast<uint32_t>(writer.strings.size());
+  header.first_root = first_root;
+  header.roots = static_cast<uint32_t>(statements.size());
+
+  string payload;
+  payload.append(reinterpret_cast<const char *>(writer.records.data()),
+                 writer.records.size() * sizeof(Record));
+  payload.append(reinterpret_cast<const char *>(writer.children.data()),
+                 writer.children.size() * sizeof(uint32_t));
+  payload.append(writer.strings);
+  header.checksum = hash(payload);
+
+  // Written aside and renamed into place, so concurrent runs never see a
+  // partial file. Named per thread too, for --batch.
+  string temporary = path + ".tmp" + to_string(getpid()) + "." +
+                     to_string(std::hash<thread::id>()(this_thread::get_id()));
+  ofstream out(temporary, ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(payload.data(), static_cast<streamsize>(payload.size()));
+  out.close();
+
+  if (!out || rename(temporary.c_str(), path.c_str()) != 0) {
+    remove(temporary.c_str());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,51 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// On-disk cache of parsed and optimized programs, behind --cache.
+//
+// A cache file holds a header, then every AST node as a fixed-size record,
+// then the child lists of blocks and of the program itself, then the bytes of
+// string literals. Nodes refer to each other by record index and to their
+// token's lexeme by offset into the source, so the file has no pointers in
+// it and is mapped and read in place. Children come before their parents,
+// which lets a single forward pass rebuild the tree.
+//
+// The header keys the file to the source's length and hash, the optimization
+// level and VERSION, and holds a checksum of the rest, so a stale, foreign or
+// damaged file is simply a miss. Files are in host byte order and meant for
+// the machine that wrote them.
+class ProgramCache final {
+public:
+  // Bump whenever the AST or the file layout changes.
+  static constexpr uint32_t VERSION = 2;
+
+  // Where the cache for script lives: next to it, or under directory named
+  // after the source hash when directory is not empty.
+  static string path_for(const string &script, const string &directory,
+                         string_view source);
+
+  // Rebuilds the program cached at path, returning false on any mismatch or
+  // damage. Tokens point into source, as if it had been scanned. The nodes
+  // live in one arena owned by the top level statements, so a subtree is
+  // only valid while they are held.
+  static bool load(const string &path, string_view source, int optimization,
+                   vector<shared_ptr<Stmt>> &statements);
+  // Writes the program to path, before the Resolver or the engines have
+  // annotated it. Returns false if it could not, which callers may ignore.
+  static bool save(const string &path, string_view source, int optimization,
+                   const vector<shared_ptr<Stmt>> &statements);
+
+  static uint64_t hash(string_view source);
+};
+
+#endif
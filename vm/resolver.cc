@@ -0,0 +1,118 @@
+#include "vm/resolver.h"
+
+void Resolver::resolve(const vector<shared_ptr<Stmt>> &statements) {
+  for (const shared_ptr<Stmt> &statement : statements) {
+    resolve(statement);
+  }
+}
+
+void Resolver::resolve(const shared_ptr<Expr> &expr) { expr->accept(this); }
+
+void Resolver::resolve(const shared_ptr<Stmt> &stmt) {
+  if (stmt != nullptr) {
+    stmt->accept(this);
+  }
+}
+
+void Resolver::resolve_local(const Token &name, int &depth, int &slot) {
+  for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; i--) {
+    auto local = scopes[i].find(name.lexeme());
+
+    if (local != scopes[i].end()) {
+      depth = static_cast<int>(scopes.size()) - 1 - i;
+      slot = local->second;
+      return;
+    }
+  }
+
+  depth = -1;
+  slot = -1;
+}
+
+int Resolver::resolve_global(const Token &name) {
+  return globals != nullptr ? globals->slot(string(name.lexeme())) : -1;
+}
+
+void Resolver::visitBinaryExpr(Binary &expr) {
+  resolve(expr.left);
+  resolve(expr.right);
+}
+
+void Resolver::visitGroupingExpr(Grouping &expr) { resolve(expr.expression); }
+
+void Resolver::visitLiteralExpr(Literal &expr) { return; }
+
+void Resolver::visitUnaryExpr(Unary &expr) { resolve(expr.right); }
+
+void Resolver::visitVariableExpr(Variable &expr) {
+  resolve_local(expr.name, expr.depth, expr.slot);
+
+  if (expr.depth == -1) {
+    expr.global = resolve_global(expr.name);
+  }
+}
+
+void Resolver::visitAssignExpr(Assign &expr) {
+  resolve(expr.value);
+  resolve_local(expr.name, expr.depth, expr.slot);
+
+  if (expr.depth == -1) {
+    expr.global = resolve_global(expr.name);
+  }
+}
+
+void Resolver::visitLogicalExpr(Logical &expr) {
+  resolve(expr.left);
+  resolve(expr.right);
+}
+
+void Resolver::visitExpressionStmt(Expression &stmt) { resolve(stmt.expr); }
+
+void Resolver::visitPrintStmt(Print &stmt) { resolve(stmt.expr); }
+
+void Resolver::visitVarStmt(Var &stmt) {
+  // The initializer is resolved before the name is declared, so it still sees
+  // any outer variable with the same name.
+  if (stmt.initializer != nullptr) {
+    resolve(stmt.initializer);
+  }
+
+  if (scopes.empty()) {
+    stmt.slot = -1;
+    stmt.global = resolve_global(stmt.name);
+    return;
+  }
+
+  map<string_view, int> &scope = scopes.back();
+  auto existing = scope.find(stmt.name.lexeme());
+
+  // Environment::define never overwrote a binding, so the first declaration
+  // in a block wins and later ones only evaluate their initializer.
+  if (existing != scope.end()) {
+    stmt.slot = existing->second;
+    stmt.redeclaration = true;
+    return;
+  }
+
+  stmt.slot = static_cast<int>(scope.size());
+  stmt.redeclaration = false;
+  scope.insert(pair<string_view, int>(stmt.name.lexeme(), stmt.slot));
+}
+
+void Resolver::visitBlockStmt(Block &stmt) {
+  scopes.push_back(map<string_view, int>());
+  resolve(stmt.statements);
+  stmt.locals = static_cast<int>(scopes.back().size());
+  scopes.pop_back();
+}
+
+void Resolver::visitIfStmt(If &stmt) {
+  resolve(stmt.condition);
+  resolve(stmt.then_branch);
+  resolve(stmt.else_branch);
+}
+
+void Resolver::visitWhileStmt(While &stmt) {
+  resolve(stmt.condition);
+  resolve(stmt.body);
+}
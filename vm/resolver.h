@@ -0,0 +1,55 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "vm/environment.h"
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include "vm/token.h"
+#include <map>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Static pass run between Parser::parse() and Interpreter::interpret(). It
+// annotates every block local reference with the number of blocks between the
+// reference and the declaration (depth) and the index of the variable within
+// the declaring block (slot), so the Interpreter can address locals in a flat
+// frame array instead of walking Environment maps.
+//
+// Given the environment the program will run against, it also gives every
+// global a slot there, so the Interpreter never has to look one up by name
+// and the tree is not written to while it runs.
+class Resolver final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  explicit Resolver(Environment *globals = nullptr) : globals(globals) {}
+
+  void resolve(const vector<shared_ptr<Stmt>> &statements);
+
+  void visitBinaryExpr(Binary &expr);
+  void visitGroupingExpr(Grouping &expr);
+  void visitLiteralExpr(Literal &expr);
+  void visitUnaryExpr(Unary &expr);
+  void visitVariableExpr(Variable &expr);
+  void visitAssignExpr(Assign &expr);
+  void visitLogicalExpr(Logical &expr);
+
+  void visitExpressionStmt(Expression &stmt);
+  void visitPrintStmt(Print &stmt);
+  void visitVarStmt(Var &stmt);
+  void visitBlockStmt(Block &stmt);
+  void visitIfStmt(If &stmt);
+  void visitWhileStmt(While &stmt);
+
+private:
+  Environment *globals;
+  vector<map<string_view, int>> scopes;
+
+  void resolve(const shared_ptr<Expr> &expr);
+  void resolve(const shared_ptr<Stmt> &stmt);
+  void resolve_local(const Token &name, int &depth, int &slot);
+  int resolve_global(const Token &name);
+};
+
+#endif
@@ -1,18 +1,255 @@
 #include "vm/scanner.h"
 #include <__nullptr>
+#include <array>
+#include <charconv>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+enum CharClass : uint8_t { ALPHA = 1, DIGIT = 2, BLANK = 4 };
+
+constexpr std::array<uint8_t, 256> make_char_classes() {
+  std::array<uint8_t, 256> classes{};
+
+  for (int c = 'a'; c <= 'z'; c++)
+    classes[c] = ALPHA;
+  for (int c = 'A'; c <= 'Z'; c++)
+    classes[c] = ALPHA;
+  for (int c = '0'; c <= '9'; c++)
+    classes[c] = DIGIT;
+
+  classes['_'] = ALPHA;
+  classes[' '] = BLANK;
+  classes['\t'] = BLANK;
+  classes['\r'] = BLANK;
+  return classes;
+}
+
+constexpr std::array<uint8_t, 256> char_classes = make_char_classes();
+
+inline bool has_class(char c, uint8_t mask) {
+  return char_classes[static_cast<unsigned char>(c)] & mask;
+}
+
+inline bool is_digit(char c) { return has_class(c, DIGIT); }
+
+inline bool is_alpha(char c) { return has_class(c, ALPHA); }
+
+inline bool is_alpha_numeric(char c) { return has_class(c, ALPHA | DIGIT); }
+
+struct Keyword {
+  std::string_view text;
+  TokenType type;
+};
+
+constexpr Keyword keywords[] = {
+    {"and", TokenType::AND},       {"class", TokenType::CLASS},
+    {"else", TokenType::ELSE},     {"false", TokenType::FALSE},
+    {"for", TokenType::FOR},       {"fun", TokenType::FUN},
+    {"if", TokenType::IF},         {"nil", TokenType::NIL},
+    {"or", TokenType::OR},         {"print", TokenType::PRINT},
+    {"return", TokenType::RETURN}, {"super", TokenType::SUPER},
+    {"this", TokenType::THIS},     {"true", TokenType::TRUE},
+    {"var", TokenType::VAR},       {"while", TokenType::WHILE},
+};
+
+// Collision free for the keywords above, see the static_assert below.
+constexpr size_t keyword_hash(std::string_view text) {
+  return (static_cast<unsigned char>(text.front()) * 7 +
+          static_cast<unsigned char>(text.back()) + text.size()) &
+         31;
+}
+
+constexpr std::array<Keyword, 32> make_keyword_table() {
+  std::array<Keyword, 32> table{};
+
+  for (const Keyword &keyword : keywords)
+    table[keyword_hash(keyword.text)] = keyword;
+
+  return table;
+}
+
+constexpr std::array<Keyword, 32> keyword_table = make_keyword_table();
+
+constexpr bool keyword_hash_is_perfect() {
+  for (const Keyword &keyword : keywords) {
+    if (keyword_table[keyword_hash(keyword.text)].text != keyword.text)
+      return false;
+  }
+
+  return true;
+}
+
+static_assert(keyword_hash_is_perfect(),
+              "Two keywords share a hash slot, change keyword_hash.");
+
+TokenType keyword_type(std::string_view text) {
+  if (text.size() < 2 || text.size() > 6)
+    return TokenType::IDENTIFIER;
+
+  const Keyword &keyword = keyword_table[keyword_hash(text)];
+  return keyword.text == text ? keyword.type : TokenType::IDENTIFIER;
+}
+
+#ifdef __SSE2__
+inline __m128i load(const char *data) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+
+inline unsigned equal_mask(__m128i chunk, char c) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+
+inline __m128i in_range(__m128i chunk, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+}
+
+// Bit i is set when byte i of the chunk is a letter, a digit or '_'. Bytes
+// above 0x7f compare as negative and never match.
+inline unsigned identifier_mask(__m128i chunk) {
+  __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+  __m128i matches = _mm_or_si128(in_range(lower, 'a', 'z'),
+                                 in_range(chunk, '0', '9'));
+  return _mm_movemask_epi8(matches) | equal_mask(chunk, '_');
+}
+#endif
+
+} // namespace
 
 std::vector<Token> Scanner::scan_tokens() {
-  while (still_going()) {
+  // Typical scripts average well over six bytes per token. Reserving up front
+  // avoids repeatedly copying the vector on large inputs; pages that end up
+  // unused are never touched.
+  tokens.reserve(source.size() / 6 + 1);
+
+  while (scan_next()) {
+  }
+
+  return std::move(tokens);
+}
+
+const Token &Scanner::next() {
+  tokens.clear();
+  literal_values.resize(1);
+  scan_next();
+  Stats::count(Stats::tokens);
+  return tokens.back();
+}
+
+bool Scanner::scan_next() {
+  size_t scanned = tokens.size();
+
+  while (tokens.size() == scanned) {
+    skip_whitespace();
+
+    if (!still_going()) {
+      tokens.push_back(
+          Token(TokenType::ENDOF, source.substr(source.length()), 0, line));
+      return false;
+    }
+
     start = current;
     scan_token();
   }
 
-  tokens.push_back(Token(TokenType::ENDOF, "", nullptr, line));
-  return tokens;
+  return true;
 }
 
 bool Scanner::still_going() { return current < source.length(); }
 
+void Scanner::skip_whitespace() {
+#ifdef __SSE2__
+  while (current + 16 <= source.size()) {
+    __m128i chunk = load(source.data() + current);
+    unsigned newlines = equal_mask(chunk, '\n');
+    unsigned blanks = newlines | equal_mask(chunk, ' ') |
+                      equal_mask(chunk, '\t') | equal_mask(chunk, '\r');
+    unsigned stop = ~blanks & 0xffff;
+    unsigned length = stop != 0 ? __builtin_ctz(stop) : 16;
+
+    line += __builtin_popcount(newlines & ((1u << length) - 1));
+    current += length;
+
+    if (stop != 0)
+      return;
+  }
+#endif
+
+  while (still_going()) {
+    char c = source[current];
+
+    if (c == '\n') {
+      line++;
+    } else if (!has_class(c, BLANK)) {
+      return;
+    }
+
+    current++;
+  }
+}
+
+// Offset of the first a or b at or after offset, or the end of the source.
+size_t Scanner::skip_until(size_t offset, char a, char b) const {
+#ifdef __SSE2__
+  while (offset + 16 <= source.size()) {
+    __m128i chunk = load(source.data() + offset);
+    unsigned found = equal_mask(chunk, a) | equal_mask(chunk, b);
+
+    if (found != 0)
+      return offset + __builtin_ctz(found);
+
+    offset += 16;
+  }
+#endif
+
+  while (offset < source.size() && source[offset] != a &&
+         source[offset] != b) {
+    offset++;
+  }
+
+  return offset;
+}
+
+int Scanner::count_lines(size_t from, size_t to) const {
+  int lines = 0;
+
+#ifdef __SSE2__
+  for (; from + 16 <= to; from += 16) {
+    lines += __builtin_popcount(equal_mask(load(source.data() + from), '\n'));
+  }
+#endif
+
+  for (; from < to; from++) {
+    lines += source[from] == '\n';
+  }
+
+  return lines;
+}
+
+size_t Scanner::identifier_end(size_t offset) const {
+#ifdef __SSE2__
+  while (offset + 16 <= source.size()) {
+    unsigned stop = ~identifier_mask(load(source.data() + offset)) & 0xffff;
+
+    if (stop != 0)
+      return offset + __builtin_ctz(stop);
+
+    offset += 16;
+  }
+#endif
+
+  while (offset < source.size() && is_alpha_numeric(source[offset])) {
+    offset++;
+  }
+
+  return offset;
+}
+
 void Scanner::scan_token() {
   char c = advance();
 
@@ -62,9 +299,7 @@ void Scanner::scan_token() {
   case '/':
     if (match('/')) {
       // Parsing comments
-      while (peek() != '\n' && still_going()) {
-        advance();
-      }
+      current = skip_until(current, '\n', '\n');
     } else if (match('*')) {
       // Parsing multiline comment
       multi_line_comment();
@@ -76,13 +311,6 @@ void Scanner::scan_token() {
   case '"':
     string();
     break;
-  case ' ':
-  case '\r':
-  case '\t':
-    break;
-  case '\n':
-    line++;
-    break;
   default:
     if (is_digit(c)) {
       number();
@@ -102,54 +330,33 @@ void Scanner::scan_token() {
 
 void Scanner::multi_line_comment() {
   int level = 1;
-  char peek_char;
-  char peek_next_char;
 
   while (level > 0) {
-    peek_char = peek();
-    peek_next_char = peek_next();
+    size_t next = skip_until(current, '/', '*');
+    line += count_lines(current, next);
+    current = next;
+
+    // An unterminated comment runs to the end of the file.
+    if (!still_going())
+      return;
 
-    if (peek_char == '/' && peek_next_char == '*') {
+    char c = advance();
+
+    if (c == '/' && peek() == '*') {
       level++;
       advance();
-    } else if (peek_char == '*' && peek_next_char == '/') {
+    } else if (c == '*' && peek() == '/') {
       level--;
       advance();
     }
-
-    if (peek_char == '\n') {
-      line++;
-    }
-
-    advance();
   }
 
   return;
 }
 
-bool Scanner::is_digit(char c) { return c >= '0' && c <= '9'; }
-
-bool Scanner::is_alpha(char c) {
-  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
-}
-
-bool Scanner::is_alpha_numeric(char c) { return is_alpha(c) || is_digit(c); }
-
 void Scanner::identifier() {
-  while (is_alpha_numeric(peek())) {
-    advance();
-  }
-
-  std::string text = source.substr(start, current - start);
-  TokenType type;
-
-  try {
-    type = keywords.at(text);
-  } catch (const std::exception &e) {
-    type = TokenType::IDENTIFIER;
-  }
-
-  add_token(type);
+  current = identifier_end(current);
+  add_token(keyword_type(source.substr(start, current - start)));
   return;
 }
 
@@ -166,19 +373,16 @@ void Scanner::number() {
     }
   }
 
-  std::shared_ptr<Number> value = std::make_shared<Number>(
-      std::stod(source.substr(start, current - start)));
-  add_token(TokenType::NUMBER, value);
+  double number = 0;
+  std::from_chars(source.data() + start, source.data() + current, number);
+  add_token(TokenType::NUMBER, Value(number));
   return;
 }
 
 void Scanner::string() {
-  while (peek() != '"' && still_going()) {
-    if (peek() == '\n') {
-      line++;
-    }
-    advance();
-  }
+  size_t end = skip_until(current, '"', '"');
+  line += count_lines(current, end);
+  current = end;
 
   if (!still_going()) {
     Vm::error(line, "Unterminated string.");
@@ -187,8 +391,8 @@ void Scanner::string() {
 
   advance();
 
-  std::shared_ptr<String> text = std::make_shared<String>(
-      String(source.substr(start + 1, current - start - 2)));
+  Value text = Value(
+      StringTable::intern(source.substr(start + 1, current - start - 2)));
   add_token(TokenType::STRING, text);
   return;
 }
@@ -221,12 +425,19 @@ bool Scanner::match(char expected) {
 char Scanner::advance() { return source[current++]; }
 
 void Scanner::add_token(TokenType type) {
-  add_token(type, nullptr);
+  add_token(type, Value());
   return;
 }
 
-void Scanner::add_token(TokenType type, std::shared_ptr<Object> literal) {
-  std::string text = source.substr(start, current - start);
-  tokens.push_back(Token(type, text, literal, line));
+void Scanner::add_token(TokenType type, Value literal) {
+  uint32_t index = 0;
+
+  if (!literal.is_nil()) {
+    index = static_cast<uint32_t>(literal_values.size());
+    literal_values.push_back(literal);
+  }
+
+  tokens.push_back(
+      Token(type, source.substr(start, current - start), index, line));
   return;
 }
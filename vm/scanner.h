@@ -1,42 +1,49 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
-#include "literals/number.h"
 #include "literals/string.h"
+#include "literals/value.h"
 #include "vm/ast_printer.h"
 #include "vm/expr.h"
+#include "vm/stats.h"
 #include "vm/token.h"
 #include "vm/vm.h"
-#include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Hot loops (whitespace runs, identifier bodies, string bodies and comments)
+// skip 16 bytes at a time with SSE2 where available and fall back to a
+// character class table otherwise. Keywords are recognized with a perfect
+// hash built at compile time.
 class Scanner final {
 public:
-  Scanner(std::string source) : source(source) {}
+  // The source is not copied and must outlive the scanned tokens.
+  Scanner(std::string_view source) : source(source) {}
+  // Scans the whole source and hands the tokens over, keeping no copy.
   std::vector<Token> scan_tokens();
+  // Scans a single token for streaming. The scanner keeps only that token and
+  // its literal, so the previous token and literal are released.
+  const Token &next();
+  const std::vector<Value> &literals() const { return literal_values; }
 
 private:
-  const std::string source;
+  const std::string_view source;
   std::vector<Token> tokens;
+  // Index 0 is the "no literal" entry referenced by every other token.
+  std::vector<Value> literal_values = {Value()};
 
-  int start = 0;
-  int current = 0;
+  size_t start = 0;
+  size_t current = 0;
   int line = 1;
 
-  std::map<std::string, TokenType> keywords = {
-      {"and", TokenType::AND},       {"class", TokenType::CLASS},
-      {"else", TokenType::ELSE},     {"false", TokenType::FALSE},
-      {"for", TokenType::FOR},       {"fun", TokenType::FUN},
-      {"if", TokenType::IF},         {"nil", TokenType::NIL},
-      {"or", TokenType::OR},         {"print", TokenType::PRINT},
-      {"return", TokenType::RETURN}, {"super", TokenType::SUPER},
-      {"this", TokenType::THIS},     {"true", TokenType::TRUE},
-      {"var", TokenType::VAR},       {"while", TokenType::WHILE},
-  };
-
   bool still_going();
+  bool scan_next();
+  void skip_whitespace();
+  size_t skip_until(size_t offset, char a, char b) const;
+  int count_lines(size_t from, size_t to) const;
+  size_t identifier_end(size_t offset) const;
   void scan_token();
   char advance();
   char peek();
@@ -45,12 +52,9 @@ private:
   void number();
   void multi_line_comment();
   void identifier();
-  bool is_digit(char c);
-  bool is_alpha(char c);
-  bool is_alpha_numeric(char c);
   bool match(char expected);
   void add_token(TokenType type);
-  void add_token(TokenType type, std::shared_ptr<Object> literal);
+  void add_token(TokenType type, Value literal);
 };
 
 #endif
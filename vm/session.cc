@@ -0,0 +1,4 @@
+#include "vm/session.h"
+
+Session Session::standard(cout, cerr);
+thread_local Session *Session::active = &Session::standard;
@@ -0,0 +1,60 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A syntax or runtime error, as recorded by a Session that collects errors.
+struct ScriptError {
+  enum class Kind { SYNTAX, RUNTIME };
+
+  Kind kind;
+  int line;
+  // Where on the line a syntax error is, as in "at ';'" or "at end", or
+  // empty.
+  string where;
+  string message;
+};
+
+// The state of one run of a script: the streams its output and diagnostics
+// go to, and whether it has failed. The Scanner, Parser, engines and
+// Vm::error all report to the calling thread's current session, which is
+// the standard one on cout and cerr unless a Scope installs another. Runs on
+// different threads therefore never see each other's output or errors.
+class Session final {
+public:
+  Session(ostream &out, ostream &err) : out(out), err(err) {}
+  Session(const Session &) = delete;
+  Session &operator=(const Session &) = delete;
+
+  // Makes a session the calling thread's current one while it lives.
+  class Scope final {
+  public:
+    explicit Scope(Session &session) : previous(active) { active = &session; }
+    ~Scope() { active = previous; }
+
+  private:
+    Session *previous;
+  };
+
+  static Session &current() { return *active; }
+
+  // Printed values, and the syntax and runtime errors of the script.
+  ostream &out;
+  // Diagnostics about the run itself.
+  ostream &err;
+  bool had_error = false;
+  bool had_runtime_error = false;
+  // When set, errors are appended here instead of being printed to out.
+  vector<ScriptError> *errors = nullptr;
+
+private:
+  static Session standard;
+  static thread_local Session *active;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "vm/snapshot.h"
+#include "literals/string.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+enum class Tag : uint8_t { NIL, FALSE, TRUE, NUMBER, STRING };
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t entries;
+  uint32_t bytes;
+};
+
+// One global. value holds the offset and length of a string value, or the
+// bits of a number.
+struct Entry {
+  uint32_t name_offset;
+  uint32_t name_length;
+  uint32_t value[2];
+  Tag tag;
+  uint8_t unused[3];
+};
+
+constexpr char MAGIC[4] = {'L', 'O', 'X', 'S'};
+
+const Header &header_of(const Source &file) {
+  return *reinterpret_cast<const Header *>(file.view().data());
+}
+
+const Entry *entries_of(const Source &file) {
+  return reinterpret_cast<const Entry *>(file.view().data() + sizeof(Header));
+}
+
+const char *bytes_of(const Source &file) {
+  return file.view().data() + sizeof(Header) +
+         header_of(file).entries * sizeof(Entry);
+}
+
+bool in_range(uint32_t offset, uint32_t length, uint32_t bytes) {
+  return offset <= bytes && length <= bytes - offset;
+}
+
+} // namespace
+
+unique_ptr<Snapshot> Snapshot::open(const string &path) {
+  unique_ptr<Source> file = Source::open(path);
+
+  if (file == nullptr || file->view().size() < sizeof(Header)) {
+    return nullptr;
+  }
+
+  const Header &header = header_of(*file);
+
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION ||
+      file->view().size() != sizeof(Header) +
+                                  size_t{header.entries} * sizeof(Entry) +
+                                  header.bytes) {
+    return nullptr;
+  }
+
+  // Checked once here, so restore can trust every offset.
+  const Entry *entries = entries_of(*file);
+
+  for (uint32_t i = 0; i < header.entries; i++) {
+    const Entry &entry = entries[i];
+
+    if (!in_range(entry.name_offset, entry.name_length, header.bytes) ||
+        entry.tag > Tag::STRING ||
+        (entry.tag == Tag::STRING &&
+         !in_range(entry.value[0], entry.value[1], header.bytes))) {
+      return nullptr;
+    }
+  }
+
+  return unique_ptr<Snapshot>(new Snapshot(move(file)));
+}
+
+void Snapshot::restore(Environment &globals) const {
+  const Header &header = header_of(*file);
+  const Entry *entries = entries_of(*file);
+  const char *bytes = bytes_of(*file);
+  // Strings already restored, by offset.
+  unordered_map<uint32_t, String *> strings;
+
+  for (uint32_t i = 0; i < header.entries; i++) {
+    const Entry &entry = entries[i];
+    Value value;
+
+    switch (entry.tag) {
+    case Tag::NIL:
+      break;
+    case Tag::FALSE:
+    case Tag::TRUE:
+      value = Value(entry.tag == Tag::TRUE);
+      break;
+    case Tag::NUMBER: {
+      double number;
+      memcpy(&number, entry.value, sizeof(number));
+      value = Value(number);
+      break;
+    }
+    case Tag::STRING: {
+      String *&restored = strings[entry.value[0]];
+
+      if (restored == nullptr) {
+        restored =
+            new String(std::string(bytes + entry.value[0], entry.value[1]));
+      }
+
+      value = Value(restored);
+      break;
+    }
+    }
+
+    string name(bytes + entry.name_offset, entry.name_length);
+    globals.define(globals.slot(name), value);
+  }
+}
+
+bool Snapshot::write(const string &path, const Environment &globals) {
+  // In slot order, which is definition order, so restoring recreates the
+  // slots in the same order.
+  vector<pair<int, const string *>> names;
+
+  for (const auto &[name, slot] : globals.names()) {
+    if (globals.get(slot) != nullptr) {
+      names.push_back({slot, &name});
+    }
+  }
+
+  sort(names.begin(), names.end());
+
+  vector<Entry> entries;
+  string bytes;
+  unordered_map<const String *, uint32_t> strings;
+
+  for (const auto &[slot, name] : names) {
+    const Value &value = *globals.get(slot);
+    Entry entry = {};
+    entry.name_offset = static_cast<uint32_t>(bytes.size());
+    entry.name_length = static_cast<uint32_t>(name->size());
+    bytes += *name;
+
+    if (value.is_nil()) {
+      entry.tag = Tag::NIL;
+    } else if (value.is_bool()) {
+      entry.tag = value.as_bool() ? Tag::TRUE : Tag::FALSE;
+    } else if (value.is_number()) {
+      entry.tag = Tag::NUMBER;
+      double number = value.as_number();
+      memcpy(entry.value, &number, sizeof(number));
+    } else {
+      const String *string = value.as_string();
+      auto saved = strings.find(string);
+      entry.tag = Tag::STRING;
+      entry.value[1] = static_cast<uint32_t>(string->size());
+
+      if (saved != strings.end()) {
+        entry.value[0] = saved->second;
+      } else {
+        entry.value[0] = static_cast<uint32_t>(bytes.size());
+        strings[string] = entry.value[0];
+        bytes += string->view();
+      }
+    }
+
+    entries.push_back(entry);
+  }
+
+  if (bytes.size() >= UINT32_MAX) {
+    return false;
+  }
+
+  Header header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.entries = static_cast<uint32_t>(entries.size());
+  header.bytes = static_cast<uint32_t>(bytes.size());
+
+  // Written aside and renamed into place, so a reader never sees a partial
+  // snapshot.
+  string temporary = path + ".tmp" + to_string(getpid());
+  ofstream out(temporary, ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries.data()),
+            entries.size() * sizeof(Entry));
+  out.write(bytes.data(), bytes.size());
+  out.close();
+
+  if (!out || rename(temporary.c_str(), path.c_str()) != 0) {
+    remove(temporary.c_str());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,41 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "vm/environment.h"
+#include "vm/source.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// The global variables of a finished run, saved by --snapshot-out and
+// restored by --snapshot-in before the next script runs, so a long prelude
+// of definitions is paid for once.
+//
+// The file holds a header, one fixed-size entry per defined global, then
+// the bytes of every name and string value. Numbers, booleans and nil are
+// stored inline. A string referenced by several globals is stored once and
+// restored as a single object, so the restored heap has the same shape as
+// the saved one. Restoring is a single pass over the mapped file.
+class Snapshot final {
+public:
+  // Bump whenever the layout changes.
+  static constexpr uint32_t VERSION = 1;
+
+  // Returns nullptr when the file cannot be read or is not a valid
+  // snapshot.
+  static unique_ptr<Snapshot> open(const string &path);
+  // Returns false when path could not be written.
+  static bool write(const string &path, const Environment &globals);
+
+  // Defines every saved global in globals, which must be a Heap root.
+  void restore(Environment &globals) const;
+
+private:
+  explicit Snapshot(unique_ptr<Source> file) : file(move(file)) {}
+
+  unique_ptr<Source> file;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "vm/source.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Source::Source(std::string text) : buffer(std::move(text)) {
+  data = buffer.data();
+  length = buffer.size();
+}
+
+Source::~Source() {
+  if (mapped) {
+    munmap(const_cast<char *>(data), length);
+  }
+}
+
+std::unique_ptr<Source> Source::open(const std::string &path) {
+  if (path == "-") {
+    return read(STDIN_FILENO);
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd == -1) {
+    return nullptr;
+  }
+
+  struct stat info;
+
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return nullptr;
+  }
+
+  // mmap refuses empty files, and pipes or character devices have no size to
+  // map, so both go through the buffered path.
+  if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+    std::unique_ptr<Source> source = read(fd);
+    close(fd);
+    return source;
+  }
+
+  size_t length = static_cast<size_t>(info.st_size);
+  void *data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+
+  // The Scanner makes a single forward pass.
+  madvise(data, length, MADV_SEQUENTIAL);
+  return std::unique_ptr<Source>(
+      new Source(static_cast<const char *>(data), length));
+}
+
+std::unique_ptr<Source> Source::read(int fd) {
+  std::string text;
+  size_t size = 0;
+  text.resize(1 << 16);
+
+  while (true) {
+    if (size == text.size()) {
+      text.resize(text.size() * 2);
+    }
+
+    ssize_t count = ::read(fd, &text[size], text.size() - size);
+
+    if (count == 0) {
+      break;
+    }
+
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return nullptr;
+    }
+
+    size += static_cast<size_t>(count);
+  }
+
+  text.resize(size);
+  return std::unique_ptr<Source>(new Source(std::move(text)));
+}
@@ -0,0 +1,42 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// The text of a script. Regular files are mapped read-only so the Scanner
+// works directly on the page cache without copying; stdin, pipes and other
+// files that cannot be mapped are read into a single buffer instead. Offsets
+// are size_t throughout, so scripts larger than 4GB are fine on 64-bit hosts.
+//
+// Tokens point into the source, so it must outlive everything produced from
+// it.
+class Source final {
+public:
+  // Returns nullptr when the file cannot be opened or read. A path of "-"
+  // reads standard input.
+  static std::unique_ptr<Source> open(const std::string &path);
+
+  explicit Source(std::string text);
+  ~Source();
+  Source(const Source &) = delete;
+  Source &operator=(const Source &) = delete;
+
+  std::string_view view() const { return std::string_view(data, length); }
+  bool is_mapped() const { return mapped; }
+
+private:
+  Source(const char *data, size_t length)
+      : data(data), length(length), mapped(true) {}
+
+  static std::unique_ptr<Source> read(int fd);
+
+  const char *data = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  std::string buffer;
+};
+
+#endif
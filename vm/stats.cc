@@ -0,0 +1,126 @@
+#include "vm/stats.h"
+#include <chrono>
+#include <iomanip>
+
+bool Stats::enabled = false;
+
+thread_local double Stats::scan_ms = 0;
+thread_local double Stats::parse_ms = 0;
+thread_local double Stats::optimize_ms = 0;
+thread_local double Stats::load_ms = 0;
+thread_local double Stats::execute_ms = 0;
+
+size_t Stats::tokens = 0;
+size_t Stats::statement_nodes = 0;
+size_t Stats::expression_nodes = 0;
+
+size_t Stats::statements = 0;
+size_t Stats::binary = 0;
+size_t Stats::grouping = 0;
+size_t Stats::literal = 0;
+size_t Stats::unary = 0;
+size_t Stats::variable = 0;
+size_t Stats::assign = 0;
+size_t Stats::logical = 0;
+size_t Stats::global_lookups = 0;
+size_t Stats::local_lookups = 0;
+size_t Stats::scope_hops = 0;
+size_t Stats::scopes = 0;
+size_t Stats::objects = 0;
+
+// Counts the nodes of a tree, without evaluating anything.
+class NodeCounter final : public Visitor<void>, public StmtVisitor<void> {
+public:
+  size_t statements = 0;
+  size_t expressions = 0;
+
+  void count(const shared_ptr<Stmt> &stmt) {
+    if (stmt != nullptr) {
+      statements++;
+      stmt->accept(this);
+    }
+  }
+
+  void count(const shared_ptr<Expr> &expr) {
+    if (expr != nullptr) {
+      expressions++;
+      expr->accept(this);
+    }
+  }
+
+  void visitBinaryExpr(Binary &expr) {
+    count(expr.left);
+    count(expr.right);
+  }
+
+  void visitGroupingExpr(Grouping &expr) { count(expr.expression); }
+  void visitLiteralExpr(Literal &expr) {}
+  void visitUnaryExpr(Unary &expr) { count(expr.right); }
+  void visitVariableExpr(Variable &expr) {}
+  void visitAssignExpr(Assign &expr) { count(expr.value); }
+
+  void visitLogicalExpr(Logical &expr) {
+    count(expr.left);
+    count(expr.right);
+  }
+
+  void visitExpressionStmt(Expression &stmt) { count(stmt.expr); }
+  void visitPrintStmt(Print &stmt) { count(stmt.expr); }
+  void visitVarStmt(Var &stmt) { count(stmt.initializer); }
+
+  void visitBlockStmt(Block &stmt) {
+    for (const shared_ptr<Stmt> &statement : stmt.statements) {
+      count(statement);
+    }
+  }
+
+  void visitIfStmt(If &stmt) {
+    count(stmt.condition);
+    count(stmt.then_branch);
+    count(stmt.else_branch);
+  }
+
+  void visitWhileStmt(While &stmt) {
+    count(stmt.condition);
+    count(stmt.body);
+  }
+};
+
+double Stats::now_ms() {
+  return chrono::duration<double, milli>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Stats::count_nodes(const vector<shared_ptr<Stmt>> &statements) {
+  NodeCounter counter;
+
+  for (const shared_ptr<Stmt> &statement : statements) {
+    counter.count(statement);
+  }
+
+  statement_nodes += counter.statements;
+  expression_nodes += counter.expressions;
+}
+
+void Stats::report(ostream &out) {
+  size_t expressions =
+      binary + grouping + literal + unary + variable + assign + logical;
+
+  out << fixed << setprecision(3);
+  out << "[stats] scan " << scan_ms << " ms, parse " << parse_ms
+      << " ms, optimize " << optimize_ms << " ms, load " << load_ms
+      << " ms, execute " << execute_ms << " ms" << endl;
+  out << "[stats] tokens: " << tokens << ", nodes: "
+      << statement_nodes + expression_nodes << " (" << statement_nodes
+      << " statements, " << expression_nodes << " expressions)" << endl;
+  out << "[stats] statements executed: " << statements << endl;
+  out << "[stats] expressions evaluated: " << expressions << " (binary "
+      << binary << ", grouping " << grouping << ", literal " << literal
+      << ", unary " << unary << ", variable " << variable << ", assign "
+      << assign << ", logical " << logical << ")" << endl;
+  out << "[stats] lookups: " << global_lookups << " global, " << local_lookups
+      << " local, " << scope_hops << " scope hops" << endl;
+  out << "[stats] scopes entered: " << scopes
+      << ", objects allocated: " << objects << endl;
+}
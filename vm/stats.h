@@ -0,0 +1,65 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "vm/expr.h"
+#include "vm/stmt.h"
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+// Phase timings and counters printed by --stats.
+//
+// The execution counters are kept by the CountingInterpreter, which the tree
+// engine runs instead of the Interpreter when --stats is on, so they cost
+// nothing otherwise. The Jit is off while it counts, so every iteration of
+// every loop is counted. The other engines only report phase timings and
+// node counts.
+class Stats final {
+public:
+  static bool enabled;
+
+  // For counting outside the CountingInterpreter, at the cost of a branch.
+  static void count(size_t &counter, size_t n = 1) {
+    if (enabled)
+      counter += n;
+  }
+
+  // Wall time per phase, in milliseconds, of the scripts run on the calling
+  // thread. With --stream the scanner runs on demand from the parser, so
+  // scanning is part of parse_ms.
+  static thread_local double scan_ms;
+  static thread_local double parse_ms;
+  static thread_local double optimize_ms;
+  // Loading a program from the --cache instead of the three above.
+  static thread_local double load_ms;
+  // Resolving or compiling, and running.
+  static thread_local double execute_ms;
+
+  static size_t tokens;
+  static size_t statement_nodes;
+  static size_t expression_nodes;
+
+  static size_t statements;
+  static size_t binary;
+  static size_t grouping;
+  static size_t literal;
+  static size_t unary;
+  static size_t variable;
+  static size_t assign;
+  static size_t logical;
+  static size_t global_lookups;
+  static size_t local_lookups;
+  // Blocks walked outwards to reach a local, the depth of each lookup.
+  static size_t scope_hops;
+  static size_t scopes;
+  static size_t objects;
+
+  static double now_ms();
+  static void count_nodes(const vector<shared_ptr<Stmt>> &statements);
+  static void report(ostream &out);
+};
+
+#endif
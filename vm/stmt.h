@@ -1,7 +1,9 @@
 #ifndef STMT_H
 #define STMT_H
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 using namespace std;
@@ -12,25 +14,29 @@ class Var;
 class Block;
 class If;
 class While;
+class NativeLoop;
 
 template <class T> class StmtVisitor {
 public:
-  virtual T visitExpressionStmt(Expression stmt) = 0;
-  virtual T visitPrintStmt(Print stmt) = 0;
-  virtual T visitVarStmt(Var stmt) = 0;
-  virtual T visitBlockStmt(Block stmt) = 0;
-  virtual T visitIfStmt(If stmt) = 0;
-  virtual T visitWhileStmt(While stmt) = 0;
+  virtual T visitExpressionStmt(Expression &stmt) = 0;
+  virtual T visitPrintStmt(Print &stmt) = 0;
+  virtual T visitVarStmt(Var &stmt) = 0;
+  virtual T visitBlockStmt(Block &stmt) = 0;
+  virtual T visitIfStmt(If &stmt) = 0;
+  virtual T visitWhileStmt(While &stmt) = 0;
 };
 
 class Stmt {
 public:
   virtual void accept(StmtVisitor<void> *visitor) = 0;
+
+  // Line the statement starts on, set by the Parser.
+  uint32_t line = 0;
 };
 
 class Expression final : public Stmt {
 public:
-  Expression(shared_ptr<Expr> expr) : expr(expr) {}
+  Expression(shared_ptr<Expr> expr) : expr(move(expr)) {}
 
   void accept(StmtVisitor<void> *visitor) {
     return visitor->visitExpressionStmt(*this);
@@ -41,7 +47,7 @@ public:
 
 class Print final : public Stmt {
 public:
-  Print(shared_ptr<Expr> expr) : expr(expr) {}
+  Print(shared_ptr<Expr> expr) : expr(move(expr)) {}
 
   void accept(StmtVisitor<void> *visitor) {
     return visitor->visitPrintStmt(*this);
@@ -53,7 +59,7 @@ public:
 class Var final : public Stmt {
 public:
   Var(Token name, shared_ptr<Expr> initializer)
-      : name(name), initializer(initializer) {}
+      : name(name), initializer(move(initializer)) {}
 
   void accept(StmtVisitor<void> *visitor) {
     return visitor->visitVarStmt(*this);
@@ -61,25 +67,34 @@ public:
 
   Token name;
   shared_ptr<Expr> initializer;
+  // Filled in by the Resolver. A slot of -1 means the variable is global, a
+  // redeclaration keeps the slot of the first declaration and is not stored.
+  int slot = -1;
+  bool redeclaration = false;
+  // Environment slot of a global, when the Resolver was given the
+  // environment.
+  int global = -1;
 };
 
 class Block final : public Stmt {
 public:
-  Block(vector<shared_ptr<Stmt>> statements) : statements(statements) {}
+  Block(vector<shared_ptr<Stmt>> statements) : statements(move(statements)) {}
 
   void accept(StmtVisitor<void> *visitor) {
     return visitor->visitBlockStmt(*this);
   }
 
   vector<shared_ptr<Stmt>> statements;
+  // Number of local slots declared directly in this block.
+  int locals = 0;
 };
 
 class If final : public Stmt {
 public:
   If(shared_ptr<Expr> condition, shared_ptr<Stmt> then_branch,
      shared_ptr<Stmt> else_branch)
-      : condition(condition), then_branch(then_branch),
-        else_branch(else_branch) {}
+      : condition(move(condition)), then_branch(move(then_branch)),
+        else_branch(move(else_branch)) {}
 
   void accept(StmtVisitor<void> *visitor) {
     return visitor->visitIfStmt(*this);
@@ -93,7 +108,7 @@ public:
 class While final : public Stmt {
 public:
   While(shared_ptr<Expr> condition, shared_ptr<Stmt> body)
-      : condition(condition), body(body) {}
+      : condition(move(condition)), body(move(body)) {}
 
   void accept(StmtVisitor<void> *visitor) {
     return visitor->visitWhileStmt(*this);
@@ -101,6 +116,12 @@ public:
 
   shared_ptr<Expr> condition;
   shared_ptr<Stmt> body;
+  // Filled in by the first Interpreter the loop runs hot in. native stays
+  // nullptr when the Jit does not support the loop. The code reads and
+  // writes its variables through the slots it is run with, so Interpreters
+  // on other threads share it.
+  once_flag jit_once;
+  shared_ptr<NativeLoop> native;
 };
 
 #endif
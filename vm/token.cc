@@ -1,15 +1,12 @@
 #include "vm/token.h"
 
 std::string Token::to_string() const {
-  std::string text = token_name() + " " + lexeme;
-
-  if (literal) {
-    text += " " + literal->to_string();
-  }
-
+  std::string text = std::string(token_name());
+  text += " ";
+  text += lexeme();
   return text;
 }
 
-std::string Token::token_name() const {
+std::string_view Token::token_name() const {
   return token_names[static_cast<int>(type)];
 }
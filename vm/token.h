@@ -1,11 +1,11 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include "literals/object.h"
-#include <memory>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
-enum class TokenType {
+enum class TokenType : uint8_t {
   // Single-character tokens.
   LEFT_PAREN,
   RIGHT_PAREN,
@@ -55,21 +55,28 @@ enum class TokenType {
   ENDOF
 };
 
+// A scanned token. The lexeme is not copied: the token points into the source
+// buffer, which has to outlive every token (and every AST node) produced from
+// it. Literal values live in the scanner's literal table, literal is the index
+// into it and 0 means the token carries no literal.
 class Token final {
 public:
-  Token(TokenType type, std::string lexeme, std::shared_ptr<Object> literal,
-        int line)
-      : type(type), literal(literal), lexeme(lexeme), line(line) {}
+  Token(TokenType type, std::string_view lexeme, uint32_t literal,
+        uint32_t line)
+      : start(lexeme.data()), length(static_cast<uint32_t>(lexeme.size())),
+        line(line), literal(literal), type(type) {}
 
+  std::string_view lexeme() const { return std::string_view(start, length); }
   std::string to_string() const;
 
-  const TokenType type;
-  const std::shared_ptr<Object> literal;
-  const std::string lexeme;
-  const int line;
+  const char *start;
+  uint32_t length;
+  uint32_t line;
+  uint32_t literal;
+  TokenType type;
 
 private:
-  const std::string token_names[39] = {
+  static constexpr std::string_view token_names[] = {
       "LEFT_PAREN", "RIGHT_PAREN",   "LEFT_BRACE", "RIGHT_BRACE", "COMMA",
       "DOT",        "MINUS",         "PLUS",       "SEMICOLON",   "SLASH",
       "STAR",       "BANG",          "BANG_EQUAL", "EQUAL",       "EQUAL_EQUAL",
@@ -79,7 +86,7 @@ private:
       "OR",         "PRINT",         "RETURN",     "SUPER",       "THIS",
       "TRUE",       "VAR",           "WHILE",      "ENDOF"};
 
-  std::string token_name() const;
+  std::string_view token_name() const;
 };
 
 #endif
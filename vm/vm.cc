@@ -1,54 +1,440 @@
 #include "vm/vm.h"
+#include <cstdlib>
+#include <fstream>
+#include <thread>
 
-bool Vm::had_error = false;
-bool Vm::had_runtime_error = false;
+Engine Vm::engine = Engine::TREE;
+bool Vm::stream = false;
+int Vm::optimization = 0;
+bool Vm::gc_stats = false;
+bool Vm::feedback_stats = false;
+std::string Vm::profile;
+bool Vm::cache = false;
+std::string Vm::cache_directory;
+unique_ptr<Snapshot> Vm::snapshot_in;
+std::string Vm::snapshot_out;
 
 int Vm::execute(int argc, char *argv[]) {
-  if (argc > 2) {
-    std::cout << "Usage: vini-lox [script]" << std::endl;
+  char *script = nullptr;
+  char *batch = nullptr;
+  int jobs = static_cast<int>(std::thread::hardware_concurrency());
+  std::string snapshot_in;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--engine=tree") {
+      Vm::engine = Engine::TREE;
+    } else if (arg == "--engine=bytecode") {
+      Vm::engine = Engine::BYTECODE;
+    } else if (arg == "--engine=closure") {
+      Vm::engine = Engine::CLOSURE;
+    } else if (arg == "--stream") {
+      Vm::stream = true;
+    } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+      Vm::optimization = arg[2] - '0';
+    } else if (arg == "--gc=full") {
+      Heap::instance().mode = GcMode::FULL;
+    } else if (arg == "--gc=incremental") {
+      Heap::instance().mode = GcMode::INCREMENTAL;
+    } else if (arg.rfind("--gc-budget=", 0) == 0 &&
+               std::atof(arg.c_str() + 12) > 0) {
+      Heap::instance().budget_us = std::atof(arg.c_str() + 12);
+    } else if (arg == "--jit=on" || arg == "--jit=off") {
+      Jit::enabled = arg == "--jit=on";
+    } else if (arg == "--gc-stats") {
+      Vm::gc_stats = true;
+    } else if (arg.rfind("--profile=", 0) == 0 && arg.size() > 10) {
+      Vm::profile = arg.substr(10);
+    } else if (arg == "--cache") {
+      Vm::cache = true;
+    } else if (arg.rfind("--cache=", 0) == 0 && arg.size() > 8) {
+      Vm::cache = true;
+      Vm::cache_directory = arg.substr(8);
+    } else if (arg.rfind("--snapshot-in=", 0) == 0 && arg.size() > 14) {
+      snapshot_in = arg.substr(14);
+    } else if (arg.rfind("--snapshot-out=", 0) == 0 && arg.size() > 15) {
+      Vm::snapshot_out = arg.substr(15);
+    } else if (arg == "--heap-stats") {
+      HeapStats::enabled = true;
+    } else if (arg.rfind("--heap-stats=", 0) == 0 &&
+               std::atof(arg.c_str() + 13) > 0) {
+      HeapStats::enabled = true;
+      HeapStats::interval_ms = std::atof(arg.c_str() + 13);
+    } else if (arg == "--stats") {
+      Stats::enabled = true;
+    } else if (arg == "--feedback-stats") {
+      Vm::feedback_stats = true;
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batch = argv[++i];
+    } else if (arg == "-j" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+      jobs = std::atoi(argv[++i]);
+    } else if (arg.rfind("-j", 0) == 0 && std::atoi(arg.c_str() + 2) > 0) {
+      jobs = std::atoi(arg.c_str() + 2);
+    } else if (script == nullptr && arg.rfind("--", 0) != 0) {
+      script = argv[i];
+    } else {
+      std::cout << "Usage: vini-lox [--engine=tree|bytecode|closure] "
+                   "[--stream] [-O0|-O1|-O2]\n"
+                   "                [--gc=full|incremental] [--gc-budget=us] "
+                   "[--gc-stats]\n"
+                   "                [--jit=on|off] [--feedback-stats] "
+                   "[--stats]\n"
+                   "                [--profile=file] [--heap-stats[=ms]] "
+                   "[--cache[=dir]]\n"
+                   "                [--snapshot-in=file] "
+                   "[--snapshot-out=file]\n"
+                   "                [--batch dir|manifest [-j N]] [script]"
+                << std::endl;
+      return 64;
+    }
+  }
+
+  // The bytecode and closure engines compile the whole program up front.
+  if (Vm::stream && Vm::engine != Engine::TREE) {
+    std::cout << "--stream requires --engine=tree." << std::endl;
+    return 64;
+  }
+
+  // A streamed script is never held as a whole program.
+  if (Vm::cache && Vm::stream) {
+    std::cout << "--cache cannot be combined with --stream." << std::endl;
+    return 64;
+  }
+
+  // The other engines keep their globals in tables of their own.
+  if ((!snapshot_in.empty() || !Vm::snapshot_out.empty()) &&
+      Vm::engine != Engine::TREE) {
+    std::cout << "--snapshot-in and --snapshot-out require --engine=tree."
+              << std::endl;
+    return 64;
+  }
+
+  if (!snapshot_in.empty() &&
+      (Vm::snapshot_in = Snapshot::open(snapshot_in)) == nullptr) {
+    std::cout << "Could not read snapshot '" << snapshot_in << "'."
+              << std::endl;
+    return 74;
+  }
+
+  // Only the tree engine knows which statement it is executing.
+  if (!Vm::profile.empty() && Vm::engine != Engine::TREE) {
+    std::cout << "--profile requires --engine=tree." << std::endl;
     return 64;
-  } else if (argc == 2) {
-    return Vm::runFile(argv[1]);
+  }
+
+  // Each runs its own subclass of the Interpreter.
+  if (Stats::enabled + !Vm::profile.empty() + HeapStats::enabled > 1) {
+    std::cout << "--stats, --profile and --heap-stats cannot be combined."
+              << std::endl;
+    return 64;
+  }
+
+  // A loop run as native code would stop being counted, or be sampled as a
+  // whole instead of line by line.
+  if (Stats::enabled || !Vm::profile.empty()) {
+    Jit::enabled = false;
+  }
+
+  if (batch != nullptr && script != nullptr) {
+    std::cout << "--batch cannot be combined with a script." << std::endl;
+    return 64;
+  }
+
+  // Their counters and files are per process, not per script.
+  if (batch != nullptr &&
+      (Stats::enabled || !Vm::profile.empty() || HeapStats::enabled ||
+       Vm::gc_stats || Vm::feedback_stats || !Vm::snapshot_out.empty())) {
+    std::cout << "--batch cannot be combined with --stats, --profile, "
+                 "--heap-stats, --gc-stats, --feedback-stats or --snapshot-out."
+              << std::endl;
+    return 64;
+  }
+
+  if (batch != nullptr) {
+    std::vector<std::string> paths;
+
+    if (!Batch::scripts(batch, paths)) {
+      std::cout << "Could not read batch '" << batch << "'." << std::endl;
+      return 74;
+    }
+
+    return Batch::run(paths, jobs, std::cout);
+  }
+
+  if (HeapStats::enabled) {
+    HeapStats::install();
+  }
+
+  if (!Vm::profile.empty() && !Profiler::start(1000)) {
+    std::cout << "Could not start the profiler." << std::endl;
+    return 70;
+  }
+
+  int status = 0;
+
+  if (script != nullptr) {
+    status = Vm::runFile(script);
   } else {
     Vm::runPrompt();
   }
 
-  return 0;
+  if (!Vm::profile.empty()) {
+    Profiler::stop();
+    std::ofstream folded(Vm::profile);
+    Profiler::write_folded(folded, script != nullptr ? script : "repl");
+
+    if (!folded) {
+      std::cerr << "Could not write profile '" << Vm::profile << "'."
+                << std::endl;
+    }
+
+    Profiler::report(std::cerr, 10);
+  }
+
+  if (Vm::gc_stats) {
+    Heap::instance().report(std::cerr);
+  }
+
+  if (Vm::feedback_stats) {
+    Interpreter::feedback.report(std::cerr);
+  }
+
+  if (HeapStats::enabled) {
+    HeapStats::report(std::cerr, "at exit");
+  }
+
+  if (Stats::enabled) {
+    Stats::objects = Heap::instance().objects_allocated();
+    Stats::report(std::cerr);
+  }
+
+  return status;
 }
 
-void Vm::run(std::string source) {
+// The tree engine's Interpreter, instrumented when --stats, --profile or
+// --heap-stats is on.
+static unique_ptr<Interpreter> make_interpreter(const std::string &profile) {
+  if (Stats::enabled) {
+    return make_unique<CountingInterpreter>();
+  }
+
+  if (!profile.empty()) {
+    return make_unique<ProfilingInterpreter>();
+  }
+
+  if (HeapStats::enabled) {
+    return make_unique<HeapAccountingInterpreter>();
+  }
+
+  return make_unique<Interpreter>();
+}
+
+// Scans, parses and optimizes source. The result is meaningless after a
+// syntax error.
+vector<shared_ptr<Stmt>> Vm::parse(std::string_view source) {
+  double start = Stats::now_ms();
   Scanner scanner = Scanner(source);
   std::vector<Token> tokens = scanner.scan_tokens();
+  Stats::count(Stats::tokens, tokens.size());
+  double scanned = Stats::now_ms();
+  Stats::scan_ms += scanned - start;
+  size_t token_bytes = tokens.capacity() * sizeof(Token);
 
-  Parser parser = Parser(tokens);
+  if (HeapStats::enabled) {
+    HeapStats::allocate(HeapStats::Category::TOKENS, token_bytes,
+                        tokens.size());
+  }
+
+  Parser parser = Parser(std::move(tokens), scanner.literals());
   vector<shared_ptr<Stmt>> statements = parser.parse();
+  double parsed = Stats::now_ms();
+  Stats::parse_ms += parsed - scanned;
 
-  if (Vm::had_error) {
+  if (HeapStats::enabled) {
+    HeapStats::release(HeapStats::Category::TOKENS, token_bytes);
+  }
+
+  if (Session::current().had_error) {
+    return statements;
+  }
+
+  if (Stats::enabled) {
+    Stats::count_nodes(statements);
+  }
+
+  statements = Optimizer(Vm::optimization).optimize(statements);
+  Stats::optimize_ms += Stats::now_ms() - parsed;
+  return statements;
+}
+
+// Runs source, loading its program from the cache file when one is given
+// and still valid, and refreshing the file otherwise.
+void Vm::run(std::string_view source, const std::string &cache) {
+  vector<shared_ptr<Stmt>> statements;
+  double start = Stats::now_ms();
+  bool loaded = !cache.empty() &&
+                ProgramCache::load(cache, source, Vm::optimization, statements);
+  Stats::load_ms += loaded ? Stats::now_ms() - start : 0;
+
+  if (!loaded) {
+    statements = Vm::parse(source);
+
+    if (Session::current().had_error) {
+      return;
+    }
+
+    // A cache that cannot be written just leaves the next run uncached.
+    if (!cache.empty()) {
+      ProgramCache::save(cache, source, Vm::optimization, statements);
+    }
+  }
+
+  start = Stats::now_ms();
+  size_t nodes = 0;
+  size_t ast_bytes = 0;
+
+  if (HeapStats::enabled) {
+    ast_bytes = HeapStats::ast_bytes(statements, nodes);
+    HeapStats::allocate(HeapStats::Category::AST, ast_bytes, nodes);
+  }
+
+  Vm::run_statements(statements);
+  Stats::execute_ms += Stats::now_ms() - start;
+
+  if (HeapStats::enabled) {
+    HeapStats::release(HeapStats::Category::AST, ast_bytes);
+  }
+}
+
+void Vm::run_statements(const vector<shared_ptr<Stmt>> &statements) {
+  if (Vm::engine == Engine::BYTECODE) {
+    Compiler compiler = Compiler();
+    Chunk chunk = compiler.compile(statements);
+
+    if (Session::current().had_error) {
+      return;
+    }
+
+    Machine machine = Machine();
+    machine.interpret(chunk);
+    return;
+  }
+
+  if (Vm::engine == Engine::CLOSURE) {
+    ClosureCompiler closures = ClosureCompiler();
+    closures.interpret(statements);
     return;
   }
 
-  Interpreter interpreter = Interpreter();
-  interpreter.interpret(statements);
+  unique_ptr<Interpreter> interpreter = make_interpreter(Vm::profile);
+  Vm::restore_snapshot(*interpreter);
+
+  Resolver resolver = Resolver(&interpreter->global_environment());
+  resolver.resolve(statements);
+  interpreter->interpret(statements);
+  Vm::save_snapshot(*interpreter);
   return;
 }
 
-int Vm::runFile(char *path) {
-  std::string source, line;
-  std::ifstream input_file(path);
+// Runs each top level declaration as soon as it is parsed and drops it
+// afterwards, so memory stays flat on long scripts and output starts right
+// away. Declarations before the first syntax error have already run; after it
+// nothing else is executed, but parsing continues so every syntax error is
+// still reported. A runtime error stops the script.
+void Vm::run_stream(std::string_view source) {
+  Scanner scanner = Scanner(source);
+  Parser parser = Parser(scanner);
+  Optimizer optimizer = Optimizer(Vm::optimization);
+  unique_ptr<Interpreter> interpreter = make_interpreter(Vm::profile);
+  Resolver resolver = Resolver(&interpreter->global_environment());
+  Vm::restore_snapshot(*interpreter);
+
+  while (!parser.is_at_end()) {
+    double start = Stats::now_ms();
+    vector<shared_ptr<Stmt>> statement = {parser.parse_declaration()};
+    double parsed = Stats::now_ms();
+    Stats::parse_ms += parsed - start;
+
+    if (Session::current().had_error) {
+      continue;
+    }
+
+    if (Stats::enabled) {
+      Stats::count_nodes(statement);
+    }
+
+    statement = optimizer.optimize(statement);
+    double optimized = Stats::now_ms();
+    Stats::optimize_ms += optimized - parsed;
+    size_t nodes = 0;
+    size_t ast_bytes = 0;
 
-  while (getline(input_file, line)) {
-    source += line;
+    if (HeapStats::enabled) {
+      ast_bytes = HeapStats::ast_bytes(statement, nodes);
+      HeapStats::allocate(HeapStats::Category::AST, ast_bytes, nodes);
+    }
+
+    resolver.resolve(statement);
+    interpreter->interpret(statement);
+    Stats::execute_ms += Stats::now_ms() - optimized;
+
+    if (HeapStats::enabled) {
+      HeapStats::release(HeapStats::Category::AST, ast_bytes);
+    }
+
+    if (Session::current().had_runtime_error) {
+      return;
+    }
+  }
+
+  Vm::save_snapshot(*interpreter);
+}
+
+void Vm::restore_snapshot(Interpreter &interpreter) {
+  if (Vm::snapshot_in != nullptr) {
+    Vm::snapshot_in->restore(interpreter.global_environment());
   }
+}
+
+// Only a script that ran to completion leaves a snapshot behind.
+void Vm::save_snapshot(Interpreter &interpreter) {
+  Session &session = Session::current();
+
+  if (Vm::snapshot_out.empty() || session.had_error ||
+      session.had_runtime_error) {
+    return;
+  }
+
+  if (!Snapshot::write(Vm::snapshot_out, interpreter.global_environment())) {
+    session.err << "Could not write snapshot '" << Vm::snapshot_out << "'."
+                << std::endl;
+  }
+}
 
-  input_file.close();
+int Vm::runFile(char *path) {
+  std::unique_ptr<Source> source = Source::open(path);
+
+  if (source == nullptr) {
+    Session::current().out << "Could not read file '" << path << "'."
+                           << std::endl;
+    return 74;
+  }
 
-  Vm::run(source);
+  if (Vm::stream) {
+    Vm::run_stream(source->view());
+  } else if (Vm::cache) {
+    std::string_view text = source->view();
+    Vm::run(text, ProgramCache::path_for(path, Vm::cache_directory, text));
+  } else {
+    Vm::run(source->view());
+  }
 
-  if (Vm::had_error) {
+  if (Session::current().had_error) {
     return 65;
   }
 
-  if (Vm::had_runtime_error) {
+  if (Session::current().had_runtime_error) {
     return 70;
   }
 
@@ -66,7 +452,7 @@ int Vm::runPrompt() {
       break;
 
     Vm::run(source);
-    Vm::had_error = false;
+    Session::current().had_error = false;
   }
 
   return 0;
@@ -81,20 +467,41 @@ void Vm::error(Token token, std::string message) {
   if (token.type == TokenType::ENDOF) {
     Vm::report(token.line, " at end", message);
   } else {
-    Vm::report(token.line, " at '" + token.lexeme + "'", message);
+    Vm::report(token.line, " at '" + std::string(token.lexeme()) + "'",
+               message);
   }
 
   return;
 }
 
 void Vm::report(int line, std::string where, std::string message) {
-  std::cout << "[line " << line << "] Error" << where << ": " << message
-            << std::endl;
-  Vm::had_error = true;
+  Session &session = Session::current();
+  session.had_error = true;
+
+  if (session.errors != nullptr) {
+    session.errors->push_back({ScriptError::Kind::SYNTAX, line,
+                               where.empty() ? where : where.substr(1),
+                               message});
+    return;
+  }
+
+  session.out << "[line " << line << "] Error" << where << ": " << message
+              << std::endl;
   return;
 }
 
 void Vm::runtime_error(Token op, std::string message) {
-  cout << message << "\n[line " << op.line << "]" << endl;
-  Vm::had_runtime_error = true;
+  Vm::runtime_error(op.line, message);
+}
+
+void Vm::runtime_error(int line, std::string message) {
+  Session &session = Session::current();
+  session.had_runtime_error = true;
+
+  if (session.errors != nullptr) {
+    session.errors->push_back({ScriptError::Kind::RUNTIME, line, "", message});
+    return;
+  }
+
+  session.out << message << "\n[line " << line << "]" << endl;
 }
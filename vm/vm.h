@@ -1,30 +1,67 @@
 #ifndef VM_H
 #define VM_H
 
+#include "literals/heap.h"
 #include "vm/ast_printer.h"
+#include "vm/batch.h"
+#include "vm/chunk.h"
+#include "vm/closure_compiler.h"
+#include "vm/compiler.h"
 #include "vm/interpreter.h"
+#include "vm/jit.h"
+#include "vm/machine.h"
+#include "vm/heap_stats.h"
+#include "vm/optimizer.h"
 #include "vm/parser.h"
+#include "vm/profiler.h"
+#include "vm/program_cache.h"
+#include "vm/resolver.h"
 #include "vm/scanner.h"
+#include "vm/session.h"
+#include "vm/snapshot.h"
+#include "vm/source.h"
+#include "vm/stats.h"
 #include "vm/stmt.h"
 #include "vm/token.h"
-#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+enum class Engine { TREE, BYTECODE, CLOSURE };
+
+class Interpreter;
+
 class Vm final {
 public:
   static int execute(int argc, char *argv[]);
   static void error(int line, std::string message);
   static void error(Token token, std::string message);
   static void runtime_error(Token op, std::string message);
+  static void runtime_error(int line, std::string message);
 
 private:
-  static bool had_error;
-  static bool had_runtime_error;
+  friend class Batch;
+
+  static Engine engine;
+  static bool stream;
+  static int optimization;
+  static bool gc_stats;
+  static bool feedback_stats;
+  static std::string profile;
+  static bool cache;
+  static std::string cache_directory;
+  static unique_ptr<Snapshot> snapshot_in;
+  static std::string snapshot_out;
 
   static int runFile(char *path);
-  static void run(std::string source);
+  static vector<shared_ptr<Stmt>> parse(std::string_view source);
+  static void run(std::string_view source, const std::string &cache = "");
+  static void run_statements(const vector<shared_ptr<Stmt>> &statements);
+  static void run_stream(std::string_view source);
+  static void restore_snapshot(Interpreter &interpreter);
+  static void save_snapshot(Interpreter &interpreter);
   static int runPrompt();
   static void report(int line, std::string where, std::string message);
 };